@@ -0,0 +1,74 @@
+#include "helpers.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+using namespace etcetera;
+
+/*
+ * Compares the bulk byteswap kernels with swapping one value at a time. The
+ * reference is the union and std::swap loop NumberType and Enum used before
+ * the kernels, speedups are given relative to it.
+ * */
+template <typename T, typename F>
+static double throughput(std::vector<T> &values, size_t rounds, F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < rounds; r++) {
+    fn(values.data(), values.size());
+    asm volatile("" : : "r"(values.data()) : "memory");
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return values.size() * sizeof(T) * rounds / elapsed.count() / 1e9;
+}
+
+// the per element swap NumberType and Enum used to do
+template <typename T> static T swap_union(T value) {
+  union {
+    T value;
+    char bytes[sizeof(T)];
+  } bswap;
+  bswap.value = value;
+  for (size_t i = 0; i < sizeof(T) / 2; i++) {
+    std::swap(bswap.bytes[i], bswap.bytes[sizeof(T) - i - 1]);
+  }
+  return bswap.value;
+}
+
+template <typename T> static void run(const char *name) {
+  std::vector<T> values(1 << 20);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<T>(i * 0x0102030405060708ull);
+  }
+  const size_t rounds = 200;
+
+  double original = throughput(values, rounds, [](T *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      p[i] = swap_union(p[i]);
+    }
+  });
+  double per_element = throughput(values, rounds, [](T *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      p[i] = swap_endian<std::endian::big>(p[i]);
+    }
+  });
+  double scalar = throughput(values, rounds, byteswap::scalar<sizeof(T)>);
+  double bulk = throughput(values, rounds, byteswap_array<sizeof(T)>);
+
+  std::printf("%-8s union loop %6.2f GB/s  swap_endian %6.2f GB/s (%4.1fx)  "
+              "scalar kernel %6.2f GB/s (%4.1fx)  "
+              "dispatched kernel %6.2f GB/s (%4.1fx)\n",
+              name, original, per_element, per_element / original, scalar,
+              scalar / original, bulk, bulk / original);
+}
+
+int main() {
+  run<uint16_t>("uint16");
+  run<uint32_t>("uint32");
+  run<uint64_t>("uint64");
+  run<float>("float");
+  run<double>("double");
+  return 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+namespace etcetera {
+
+/*
+ * Arena owns the memory of all nodes created while an ArenaScope for it is
+ * active, e.g. all nodes of one parsed document.
+ *
+ * Nodes are bump allocated and their memory is only given back when the
+ * arena is destroyed, all at once. The arena must outlive every node
+ * allocated in it. It is not thread safe, use one arena per thread.
+ * */
+class Arena : public std::pmr::memory_resource {
+protected:
+  std::pmr::monotonic_buffer_resource resource;
+  size_t used = 0;
+
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    used += bytes;
+    return resource.allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *, size_t, size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+public:
+  Arena(size_t initial_size = 64 * 1024) : resource(initial_size) {}
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /*
+   * Returns the number of bytes handed out so far.
+   * */
+  size_t allocated() const { return used; }
+};
+
+// arena used by make_node on this thread, nullptr for the heap
+inline thread_local Arena *current_arena = nullptr;
+
+/*
+ * Makes the arena the target of all nodes created on this thread, until the
+ * scope ends.
+ * */
+class ArenaScope {
+  Arena *previous;
+
+public:
+  ArenaScope(Arena &arena) : previous(current_arena) { current_arena = &arena; }
+  ~ArenaScope() { current_arena = previous; }
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator=(const ArenaScope &) = delete;
+};
+
+/*
+ * Creates a node in the current arena, or on the heap if there is none. The
+ * control block lives next to the node, so no extra allocation is needed.
+ * */
+template <typename T, typename... Args>
+std::shared_ptr<T> make_node(Args &&...args) {
+  if (current_arena) {
+    return std::allocate_shared<T>(
+        std::pmr::polymorphic_allocator<T>(current_arena),
+        std::forward<Args>(args)...);
+  }
+  return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+} // namespace etcetera
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "basic.hpp"
+#include "number.hpp"
+#include "parallel.hpp"
+
+#include <list>
+#include <span>
+#include <unordered_map>
 
 namespace etcetera {
 
@@ -14,16 +20,27 @@ protected:
   FSizeFn size_fn;
   FTypeFn type_constructor;
   std::vector<std::shared_ptr<Base>> data;
+  // fixed size of the elements, set on first use
+  std::optional<std::optional<size_t>> cached_stride;
+
+  std::optional<size_t> element_stride() {
+    if (!cached_stride) {
+      cached_stride = type_constructor()->fixed_size();
+    }
+    return cached_stride.value();
+  }
 
 public:
   using Base::get;
   using Base::get_field;
   using Base::get_offset;
+  using Base::parse;
+  using Base::build;
   Array(PrivateBase, size_t size, FTypeFn m_type_constructor)
       : Base(PrivateBase()), size(size), type_constructor(m_type_constructor) {}
   static std::shared_ptr<Array> create(size_t size,
                                        FTypeFn m_type_constructor) {
-    return std::make_shared<Array>(PrivateBase(), size, m_type_constructor);
+    return make_node<Array>(PrivateBase(), size, m_type_constructor);
   }
 
   Array(PrivateBase, FSizeFn size_fn, FTypeFn m_type_constructor)
@@ -31,12 +48,68 @@ public:
         type_constructor(m_type_constructor) {}
   static std::shared_ptr<Array> create(FSizeFn size_fn,
                                        FTypeFn m_type_constructor) {
-    return std::make_shared<Array>(PrivateBase(), size_fn, m_type_constructor);
+    if (auto size = constant_of(size_fn)) {
+      return create(size.value(), m_type_constructor);
+    }
+    return make_node<Array>(PrivateBase(), size_fn, m_type_constructor);
   }
 
-  size_t get_offset(size_t key) {
-    size_t ret = get_offset();
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<Array>(*this);
+    ret->data.clear();
+    return ret;
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(size_fn);
+  }
+
+  /*
+   * Parses fixed size elements on the pool, returns false if their size is
+   * not fixed or they do not fit.
+   * */
+  bool parse_parallel(InputCursor &cursor, ThreadPool &pool) {
+    auto stride = element_stride();
+    if (!stride) {
+      return false;
+    }
+    if (stride.value() > 0 && size > cursor.remaining() / stride.value()) {
+      // parse serially to report the failing element
+      return false;
+    }
+    data.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+      auto obj = type_constructor();
+      obj->set_parent(this);
+      obj->set_idx(i);
+      data.push_back(std::move(obj));
+    }
+    size_t offset = cursor.tell();
+    auto bytes = cursor.read(size * stride.value());
+    parse_fixed_elements(pool, data, bytes.data(), offset, stride.value());
+    cached_size = bytes.size();
+    return true;
+  }
+
+  /*
+   * Builds fixed size elements on the pool into the bytes they take up,
+   * returns false if their sizes are not fixed or not all the same.
+   * */
+  bool build_parallel(OutputCursor &cursor, ThreadPool &pool) {
+    auto stride = common_stride(data);
+    if (!stride) {
+      return false;
+    }
+    build_fixed_elements(pool, data, cursor, stride.value());
+    return true;
+  }
+
+  size_t get_offset(size_t key) override {
     custom_assert(key < data.size());
+    if (data[key]->offset_current()) {
+      return data[key]->get_offset();
+    }
+    size_t ret = get_offset();
     for (size_t i = 0; i < key; i++) {
       try {
         ret += data[i]->get_size();
@@ -47,54 +120,85 @@ public:
     return ret;
   }
 
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    for (auto &obj : data) {
+      obj->invalidate_offset();
+    }
+  }
+
+  void invalidate_offsets_after(size_t key) override {
+    for (size_t i = key + 1; i < data.size(); i++) {
+      data[i]->invalidate_offset();
+    }
+    size_changed();
+  }
+
   size_t get_size() override {
+    if (size_cache_hit()) {
+      return cached_size.value();
+    }
     size_t s = 0;
     size_t i = 0;
+    bool memoize = true;
     for (auto &obj : data) {
       try {
         s += obj->get_size();
+        memoize = memoize && obj->size_memoized();
         i += 1;
       } catch (std::exception &e) {
         throw std::runtime_error(std::to_string(i) + "->" +
                                  std::string(e.what()));
       }
     }
+    if (memoize) {
+      cached_size = s;
+    }
     return s;
   }
 
-  std::any parse(std::istream &stream) override {
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Array::parse", name, idx, cursor);
     if (size_fn) {
-      size = size_fn(this->parent);
+      size = call(size_fn);
     }
     data.clear();
-    spdlog::debug("Array::parsing {} {:02X} {}", name, (size_t)stream.tellg(),
-                  size);
+    if (current_pool && size >= current_pool->min_elements &&
+        parse_parallel(cursor, *current_pool)) {
+      return result(data);
+    }
+    data.reserve(size);
     for (size_t i = 0; i < size; i++) {
       auto obj = type_constructor();
-      obj->set_parent(weak_from_this());
+      obj->set_parent(this);
       obj->set_idx(i);
-      data.push_back(obj);
+      data.push_back(std::move(obj));
       try {
-        spdlog::debug("Array::itemparse {} {:02X} {}", name,
-                      (size_t)stream.tellg(), i);
-        data.back()->parse(stream);
-      } catch (std::exception &e) {
-        throw std::runtime_error(std::to_string(i) + "->" +
-                                 std::string(e.what()));
+        data.back()->parse(cursor);
+      } catch (...) {
+        rethrow_at(i, cursor.tell());
       }
     }
-    return data;
+    // the size may have been memoized while the elements were parsed
+    cached_size.reset();
+    memoize_size();
+    return result(data);
   }
 
-  void build(std::iostream &stream) override {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    if (current_pool && data.size() >= current_pool->min_elements &&
+        build_parallel(cursor, *current_pool)) {
+      return;
+    }
     size_t i = 0;
     for (auto &obj : data) {
       try {
-        obj->build(stream);
+        obj->build(cursor);
         i += 1;
-      } catch (std::exception &e) {
-        throw std::runtime_error(std::to_string(i) + "->" +
-                                 std::string(e.what()));
+      } catch (...) {
+        rethrow_at<BuildFailure>(i, cursor.tell());
       }
     }
   }
@@ -119,6 +223,12 @@ public:
 
   bool is_array() override { return true; }
 
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    for (auto &obj : data) {
+      fn(*obj);
+    }
+  }
+
   /*
    * This is a helper function to initialize the fields of the array.
    *
@@ -126,18 +236,18 @@ public:
    * */
   void init_fields(size_t n = 0, bool clear = false) {
     data.clear();
-    if (clear) {
-      return;
-    }
-    if (n == 0) {
-      n = size;
-    }
-    for (size_t i = 0; i < n; i++) {
-      auto obj = type_constructor();
-      obj->set_parent(weak_from_this());
-      obj->set_idx(i);
-      data.push_back(obj);
+    if (!clear) {
+      if (n == 0) {
+        n = size;
+      }
+      for (size_t i = 0; i < n; i++) {
+        auto obj = type_constructor();
+        obj->set_parent(this);
+        obj->set_idx(i);
+        data.push_back(obj);
+      }
     }
+    size_changed();
   }
 
   void parse_xml(pugi::xml_node const &node, std::string name,
@@ -148,7 +258,7 @@ public:
     for (auto &child_node : node.children(name.c_str())) {
       spdlog::debug("Array::parse_xml {} {}", name, i);
       auto obj = type_constructor();
-      obj->set_parent(weak_from_this());
+      obj->set_parent(this);
       obj->set_idx(i);
       data.push_back(obj);
       try {
@@ -159,6 +269,7 @@ public:
                                  std::string(e.what()));
       }
     }
+    cached_size.reset();
   }
 
   pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
@@ -176,6 +287,224 @@ public:
   }
 };
 
+/*
+ * LazyArray is an Array of fixed size elements, which are only parsed when
+ * they are accessed.
+ *
+ * parse records the offset and the number of elements and skips over them.
+ * get_field(i) and get(i) parse element i from the recorded cursor on first
+ * access and keep the latest cache_size elements, the least recently used
+ * one is dropped first. This allows to open a huge table and read a handful of
+ * records without touching the rest:
+ *
+ *   auto table = LazyArray::create(count, []() { return Record::create(); });
+ *   table->parse(cursor);
+ *   auto record = table->get_field<Struct>(123456).lock();
+ *
+ * The cursor keeps its InputSource alive, a plain buffer has to outlive the
+ * LazyArray. Dropped elements lose their changes, so weak_ptrs to elements
+ * have to be locked while they are used and changed elements have to be
+ * built before they are dropped. build copies the bytes of all elements that
+ * are not cached from the source. parse_xml builds the elements into a buffer
+ * and reads them from there.
+ * */
+class LazyArray : public Base {
+protected:
+  typedef std::function<size_t(std::weak_ptr<Base>)> FSizeFn;
+  typedef std::function<std::shared_ptr<Base>()> FTypeFn;
+  size_t size;
+  FSizeFn size_fn;
+  FTypeFn type_constructor;
+  size_t stride;
+  size_t cache_size;
+  // positioned at the first element
+  std::optional<InputCursor> source;
+
+  // cached elements, most recently used first
+  std::list<std::pair<size_t, std::shared_ptr<Base>>> lru;
+  std::unordered_map<size_t, decltype(lru)::iterator> cache;
+
+  static size_t stride_of(const FTypeFn &type_constructor) {
+    auto size = type_constructor()->fixed_size();
+    if (!size) {
+      throw cpptrace::runtime_error(
+          "LazyArray: the elements need a fixed size");
+    }
+    return size.value();
+  }
+
+  /*
+   * Returns element key, parses it if it is not cached.
+   * */
+  std::shared_ptr<Base> element(size_t key) {
+    custom_assert(key < size);
+    if (auto it = cache.find(key); it != cache.end()) {
+      lru.splice(lru.begin(), lru, it->second);
+      return it->second->second;
+    }
+    if (!source) {
+      throw cpptrace::runtime_error("LazyArray: not parsed name: " + name);
+    }
+    auto obj = type_constructor();
+    obj->set_parent(this);
+    obj->set_idx(key);
+    size_t from = source->tell() + key * stride;
+    try {
+      obj->parse_fixed(source->buffer().data() + from, get_offset(key));
+    } catch (...) {
+      rethrow_at(key, from);
+    }
+    if (lru.size() >= cache_size) {
+      cache.erase(lru.back().first);
+      lru.pop_back();
+    }
+    lru.emplace_front(key, std::move(obj));
+    cache[key] = lru.begin();
+    return lru.front().second;
+  }
+
+public:
+  using Base::get;
+  using Base::get_field;
+  using Base::get_offset;
+  using Base::parse;
+  using Base::build;
+  LazyArray(PrivateBase, size_t size, FSizeFn size_fn,
+            FTypeFn m_type_constructor, size_t cache_size)
+      : Base(PrivateBase()), size(size), size_fn(size_fn),
+        type_constructor(m_type_constructor),
+        stride(stride_of(m_type_constructor)),
+        cache_size(std::max<size_t>(cache_size, 1)) {}
+  static std::shared_ptr<LazyArray> create(size_t size,
+                                           FTypeFn m_type_constructor,
+                                           size_t cache_size = 256) {
+    return make_node<LazyArray>(PrivateBase(), size, nullptr,
+                                m_type_constructor, cache_size);
+  }
+  static std::shared_ptr<LazyArray> create(FSizeFn size_fn,
+                                           FTypeFn m_type_constructor,
+                                           size_t cache_size = 256) {
+    if (auto size = constant_of(size_fn)) {
+      return create(size.value(), m_type_constructor, cache_size);
+    }
+    return make_node<LazyArray>(PrivateBase(), 0, size_fn, m_type_constructor,
+                                cache_size);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<LazyArray>(*this);
+    ret->source.reset();
+    ret->lru.clear();
+    ret->cache.clear();
+    return ret;
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(size_fn);
+  }
+
+  /*
+   * Returns the number of parsed elements, that are currently cached.
+   * */
+  size_t cached() const { return lru.size(); }
+
+  bool is_array() override { return true; }
+
+  size_t length() override { return size; }
+
+  // no fixed_size, the elements are parsed from the cursor later on
+  size_t get_size() override { return size * stride; }
+  bool size_memoized() override { return true; }
+
+  size_t get_offset(size_t key) override {
+    custom_assert(key < size);
+    return get_offset() + key * stride;
+  }
+
+  void invalidate_offsets_after(size_t) override { size_changed(); }
+
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("LazyArray::parse", name, idx, cursor);
+    if (size_fn) {
+      size = call(size_fn);
+    }
+    lru.clear();
+    cache.clear();
+    if (stride > 0 && size > cursor.remaining() / stride) {
+      throw ParseFailure(cursor.tell(), "LazyArray: elements past the end");
+    }
+    source = cursor;
+    cursor.skip(size * stride);
+    return {};
+  }
+
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    for (size_t i = 0; i < size; i++) {
+      if (auto it = cache.find(i); it != cache.end()) {
+        it->second->second->build(cursor);
+      } else {
+        custom_assert(source.has_value());
+        cursor.write(source->buffer().data() + source->tell() + i * stride,
+                     stride);
+      }
+    }
+  }
+
+  std::any get() override {
+    throw cpptrace::runtime_error("LazyArray->get(): Not implemented");
+  }
+  std::any get(size_t key) override { return element(key)->get(); }
+
+  void set(size_t key, std::any value) override { element(key)->set(value); }
+
+  std::weak_ptr<Base> get_field(size_t key) override { return element(key); }
+
+  /*
+   * Parses the elements from XML and builds them into a buffer of their own,
+   * which they are parsed from on access like after parse.
+   * */
+  void parse_xml(pugi::xml_node const &node, std::string name,
+                 bool) override {
+    std::vector<std::byte> bytes;
+    size_t i = 0;
+    for (auto &child_node : node.children(name.c_str())) {
+      auto obj = type_constructor();
+      obj->set_parent(this);
+      obj->set_idx(i);
+      try {
+        obj->parse_xml(child_node, name, true);
+        if (obj->fixed_size() != stride) {
+          throw std::runtime_error("LazyArray: element size differs");
+        }
+        bytes.resize((i + 1) * stride);
+        obj->build_fixed(bytes.data() + i * stride, i * stride);
+      } catch (std::exception &e) {
+        throw std::runtime_error(std::to_string(i) + "->" +
+                                 std::string(e.what()));
+      }
+      i += 1;
+    }
+    size = i;
+    lru.clear();
+    cache.clear();
+    source = InputCursor(std::make_shared<BufferSource>(std::move(bytes)));
+  }
+
+  pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
+    for (size_t i = 0; i < size; i++) {
+      try {
+        element(i)->build_xml(parent, name);
+      } catch (std::exception &e) {
+        throw std::runtime_error(std::to_string(i) + "->" +
+                                 std::string(e.what()));
+      }
+    }
+    return parent;
+  }
+};
+
 /*
  * In contrast to construct this does not get the stream as an argument in its
  * lambda, but it gets only the parsed object itself and its parent.
@@ -205,6 +534,8 @@ public:
   using Base::get;
   using Base::get_field;
   using Base::get_offset;
+  using Base::parse;
+  using Base::build;
 
   RepeatUntil(PrivateBase, RepeatFn repeat_fn, FTypeFn m_type_constructor,
               FSizeFn size_fn)
@@ -213,21 +544,40 @@ public:
 
   static std::shared_ptr<RepeatUntil>
   create(RepeatFn repeat_fn, FTypeFn m_type_constructor, FSizeFn size_fn) {
-    return std::make_shared<RepeatUntil>(PrivateBase(), repeat_fn,
-                                         m_type_constructor, size_fn);
+    return make_node<RepeatUntil>(PrivateBase(), repeat_fn, m_type_constructor,
+                                  size_fn);
   }
 
   static std::shared_ptr<RepeatUntil> create(RepeatFn repeat_fn,
                                              FTypeFn m_type_constructor) {
-    return std::make_shared<RepeatUntil>(PrivateBase(), repeat_fn,
-                                         m_type_constructor, nullptr);
+    return make_node<RepeatUntil>(PrivateBase(), repeat_fn, m_type_constructor,
+                                  nullptr);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<RepeatUntil>(*this);
+    ret->data.clear();
+    return ret;
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(size_fn);
   }
 
   size_t length() override { return data.size(); }
 
-  size_t get_offset(size_t key) {
-    size_t ret = get_offset();
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    for (auto &obj : data) {
+      fn(*obj);
+    }
+  }
+
+  size_t get_offset(size_t key) override {
     custom_assert(key < data.size());
+    if (data[key]->offset_current()) {
+      return data[key]->get_offset();
+    }
+    size_t ret = get_offset();
     for (size_t i = 0; i < key; i++) {
       try {
         ret += data[i]->get_size();
@@ -239,70 +589,86 @@ public:
     return ret;
   }
 
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    for (auto &obj : data) {
+      obj->invalidate_offset();
+    }
+  }
+
   size_t get_size() override {
+    if (size_cache_hit()) {
+      return cached_size.value();
+    }
     size_t s = 0;
     size_t i = 0;
+    bool memoize = true;
     for (auto &obj : data) {
       try {
         s += obj->get_size();
+        memoize = memoize && obj->size_memoized();
         i += 1;
       } catch (std::exception &e) {
         throw std::runtime_error(std::to_string(i) + "->" +
                                  std::string(e.what()));
       }
     }
+    if (memoize) {
+      cached_size = s;
+    }
     return s;
   }
 
-  std::any parse(std::istream &stream) override {
-    int64_t before_offset = stream.tellg();
-    custom_assert(before_offset >= 0);
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    size_t before_offset = cursor.tell();
     data.clear();
     size_t i = 0;
 
-    int64_t opt_size = 0;
+    size_t opt_size = 0;
     if (size_fn) {
-      opt_size = (int64_t)size_fn(this->parent);
+      opt_size = call(size_fn);
     }
 
     auto check_size = [&]() -> bool {
       if (!size_fn) {
         return true;
       }
-      return stream.tellg() < (before_offset + opt_size);
+      return cursor.tell() < (before_offset + opt_size);
     };
 
     while (check_size()) {
       auto obj = type_constructor();
-      obj->set_parent(weak_from_this());
+      obj->set_parent(this);
       obj->set_idx(i);
-      data.push_back(obj);
+      data.push_back(std::move(obj));
       try {
-        data.back()->parse(stream);
+        data.back()->parse(cursor);
         i += 1;
-        if (repeat_fn(data.back(), this->parent)) {
+        if (repeat_fn(data.back(), parent_weak())) {
           break;
         }
-      } catch (std::exception &e) {
-        throw std::runtime_error(name + "[" + std::to_string(i) + "]->" +
-                                 std::string(e.what()));
+      } catch (...) {
+        rethrow_at(i, cursor.tell());
       }
     }
-    if (size_fn && (stream.tellg() > (before_offset + opt_size))) {
-      throw cpptrace::runtime_error("RepeatUntil: size limit exceeded!");
+    if (size_fn && (cursor.tell() > (before_offset + opt_size))) {
+      throw ParseFailure(cursor.tell(), "RepeatUntil: size limit exceeded");
     }
-    return data;
+    cached_size.reset();
+    memoize_size();
+    return result(data);
   }
 
-  void build(std::iostream &stream) override {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
     size_t i = 0;
     for (auto &obj : data) {
       try {
-        obj->build(stream);
+        obj->build(cursor);
         i += 1;
-      } catch (std::exception &e) {
-        throw std::runtime_error(std::to_string(i) + "->" +
-                                 std::string(e.what()));
+      } catch (...) {
+        rethrow_at<BuildFailure>(i, cursor.tell());
       }
     }
   }
@@ -319,7 +685,7 @@ public:
     for (auto &child_node : node.children(name.c_str())) {
       spdlog::debug("RepeatUntil::parse_xml {} {}", name, i);
       auto obj = type_constructor();
-      obj->set_parent(weak_from_this());
+      obj->set_parent(this);
       obj->set_idx(i);
       data.push_back(obj);
       try {
@@ -330,6 +696,7 @@ public:
                                  std::string(e.what()));
       }
     }
+    cached_size.reset();
   }
 
   pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
@@ -347,4 +714,162 @@ public:
   }
 };
 
+/*
+ * NumberArray is an Array of a NumberType, e.g. NumberArray<Int32ul>.
+ *
+ * Instead of one node per element the values are stored contiguously, parsed
+ * with a single read and exposed as a span. Elements have no fields of their
+ * own, so get_field does not work on them, use get and set instead.
+ * */
+template <typename TNumber> class NumberArray : public Base {
+public:
+  typedef typename TNumber::value_type value_type;
+  static constexpr std::endian endianess = TNumber::endianess;
+
+protected:
+  typedef std::function<size_t(std::weak_ptr<Base>)> FSizeFn;
+  size_t size;
+  FSizeFn size_fn;
+
+public:
+  using Base::get;
+  using Base::get_field;
+  using Base::get_offset;
+  using Base::parse;
+  using Base::build;
+  std::vector<value_type> value;
+
+  NumberArray(PrivateBase, FSizeFn size_fn, size_t size)
+      : Base(PrivateBase()), size(size), size_fn(size_fn) {}
+  static std::shared_ptr<NumberArray> create(size_t size) {
+    return make_node<NumberArray>(PrivateBase(), nullptr, size);
+  }
+  static std::shared_ptr<NumberArray> create(FSizeFn size_fn) {
+    if (auto size = constant_of(size_fn)) {
+      return create(size.value());
+    }
+    return make_node<NumberArray>(PrivateBase(), size_fn, 0);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<NumberArray>(*this);
+    ret->value.clear();
+    return ret;
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(size_fn);
+  }
+
+  /*
+   * Returns a view of the values, valid until the array is resized. Resize
+   * it through set, so the size and the layout of the parent follow.
+   * */
+  std::span<value_type> values() { return value; }
+
+  bool is_array() override { return true; }
+  bool has_field_nodes() override { return false; }
+
+  size_t length() override { return value.size(); }
+
+  size_t get_size() override { return value.size() * sizeof(value_type); }
+  bool size_memoized() override { return true; }
+  std::optional<size_t> fixed_size() override {
+    if (size_fn) {
+      return std::nullopt;
+    }
+    return size * sizeof(value_type);
+  }
+
+  size_t get_offset(size_t key) override {
+    custom_assert(key < value.size());
+    return get_offset() + key * sizeof(value_type);
+  }
+
+  void invalidate_offsets_after(size_t) override { size_changed(); }
+
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("NumberArray::parse", name, idx, cursor);
+    if (size_fn) {
+      size = call(size_fn);
+    }
+    value.resize(size);
+    cursor.read_array<value_type, endianess>(value.data(), value.size());
+    return result(value);
+  }
+
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    cursor.write_array<value_type, endianess>(value.data(), value.size());
+  }
+
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    value.resize(size);
+    // value.data() may be null if the array is empty
+    if (size != 0) {
+      std::memcpy(value.data(), data, size * sizeof(value_type));
+    }
+    swap_endian_n<endianess>(value.data(), value.size());
+    return result(value);
+  }
+
+  void build_fixed(std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    custom_assert(value.size() == size);
+    if (size != 0) {
+      std::memcpy(data, value.data(), size * sizeof(value_type));
+    }
+    if constexpr (endianess != std::endian::native) {
+      byteswap_array<sizeof(value_type)>(data, size);
+    }
+  }
+
+  std::any get() override { return value; }
+  std::any get(size_t key) override { return value.at(key); }
+
+  /*
+   * Takes either a std::vector of the value type or, like Array, a
+   * std::vector<std::any>.
+   * */
+  void set(std::any v) override {
+    if (auto values = std::any_cast<std::vector<value_type>>(&v)) {
+      value = *values;
+    } else {
+      auto anys = std::any_cast<std::vector<std::any>>(v);
+      value.resize(anys.size());
+      for (size_t i = 0; i < anys.size(); i++) {
+        value[i] = std::any_cast<value_type>(anys[i]);
+      }
+    }
+    size = value.size();
+    size_changed();
+  }
+  void set(size_t key, std::any v) override {
+    value.at(key) = std::any_cast<value_type>(v);
+  }
+
+  void parse_xml(pugi::xml_node const &node, std::string name, bool) override {
+    value.clear();
+    for (auto &child_node : node.children(name.c_str())) {
+      auto element = TNumber::create();
+      element->parse_xml(child_node, name, true);
+      value.push_back(element->value);
+    }
+    size = value.size();
+    size_changed();
+  }
+
+  pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
+    auto element = TNumber::create();
+    for (auto &v : value) {
+      auto child_node = parent.append_child(name.c_str());
+      element->value = v;
+      element->build_xml(child_node, name);
+    }
+    return parent;
+  }
+};
+
 } // namespace etcetera
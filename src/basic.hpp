@@ -4,13 +4,23 @@
 #include <iostream>
 
 #include <any>
+#include <array>
 #include <cassert>
+#include <expected>
 #include <functional>
+#include <limits>
 #include <istream>
 #include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
 #include <tsl/ordered_map.h>
+#include <variant>
 
+#include "arena.hpp"
+#include "cursor.hpp"
 #include "helpers.hpp"
+#include "trace.hpp"
 
 #include <pugixml.hpp>
 #include <spdlog/spdlog.h>
@@ -19,26 +29,250 @@
 
 namespace etcetera {
 
+/*
+ * Counts how often a memoized get_size was answered without recomputation
+ * (hits) and how often it had to be computed (misses). Counted per thread.
+ * */
+struct SizeCacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+};
+
+inline thread_local SizeCacheStats size_cache_stats;
+
+inline SizeCacheStats get_size_cache_stats() { return size_cache_stats; }
+inline void reset_size_cache_stats() { size_cache_stats = {}; }
+
+// false while Base::parse_tree runs, parse returns nothing then
+inline thread_local bool collect_results = true;
+
+/*
+ * A typed view of the value of a simple object, so it can be read without
+ * boxing it in a std::any. See Base::get_as.
+ * */
+typedef std::variant<std::monostate, const int8_t *, const uint8_t *,
+                     const int16_t *, const uint16_t *, const int32_t *,
+                     const uint32_t *, const int64_t *, const uint64_t *,
+                     const float *, const double *, const std::string *,
+                     const std::vector<uint8_t> *>
+    ValueView;
+
+template <typename T, typename TVariant> struct variant_has;
+template <typename T, typename... Ts>
+struct variant_has<T, std::variant<Ts...>>
+    : std::bool_constant<(std::is_same_v<T, Ts> || ...)> {};
+
+/*
+ * Returns a view of value, or an empty view if its type is not part of
+ * ValueView.
+ * */
+template <typename T> inline ValueView make_value_view(const T &value) {
+  if constexpr (variant_has<const T *, ValueView>::value) {
+    return &value;
+  } else {
+    return {};
+  }
+}
+
+/*
+ * A path of keys below an object resolved into child indices, see
+ * Base::field_index.
+ * */
+typedef std::vector<size_t> ResolvedPath;
+
+class Expr;
+template <typename F> const Expr *expr_of(const F &fn);
+
 class Base : public std::enable_shared_from_this<Base> {
 protected:
   std::type_info const &type_ = typeid(Base);
 
   std::string name;
-  size_t idx;
-  std::weak_ptr<Base> parent;
+  size_t idx = 0;
+  // the parent owns this object, so a plain pointer to it stays valid
+  Base *parent = nullptr;
+  // absolute offset recorded by parse and build, see get_offset
+  std::optional<size_t> cached_offset;
+  // memoized result of get_size, dropped by size_changed
+  std::optional<size_t> cached_size;
+  // key paths used by get<T>(key, args...) and their resolved paths, empty
+  // if they can not be resolved
+  std::vector<std::pair<std::vector<std::string>, std::optional<ResolvedPath>>>
+      path_cache;
+  static constexpr size_t max_cached_paths = 16;
 
   struct PrivateBase {};
 
+  /*
+   * Returns the value as the result of parse, or nothing inside parse_tree.
+   * */
+  template <typename T> static std::any result(T &&value) {
+    if (!collect_results) {
+      return {};
+    }
+    return std::forward<T>(value);
+  }
+
+  // cached_path of the keys
+  template <typename... Ks> Base *cached_field(Ks &&...keys) {
+    std::array<std::string_view, sizeof...(Ks)> path = {
+        std::string_view(keys)...};
+    return cached_path(path);
+  }
+
+  /*
+   * Returns the parent as passed to callbacks.
+   * */
+  std::weak_ptr<Base> parent_weak() const {
+    return parent ? parent->weak_from_this() : std::weak_ptr<Base>();
+  }
+  Base &parent_ref() const {
+    if (!parent) {
+      throw cpptrace::runtime_error("No parent name: " + name);
+    }
+    return *parent;
+  }
+
+  /*
+   * Calls a size, offset or condition callback for the parent. Expressions
+   * are evaluated on the parent directly, lambdas get it as a std::weak_ptr.
+   * */
+  template <typename F> auto call(const F &fn) {
+    using R = decltype(fn(std::weak_ptr<Base>()));
+    if (auto expr = expr_of(fn)) {
+      return static_cast<R>(expr->evaluate(parent_ref()));
+    }
+    return fn(parent_weak());
+  }
+
+  /*
+   * Stores value in the field a callback reads, so that it returns value,
+   * see Expr::solve. Lambdas can not be solved.
+   * */
+  template <typename F> void assign(const F &fn, int64_t value) {
+    auto expr = expr_of(fn);
+    if (!expr) {
+      throw cpptrace::runtime_error("assign: not an expression name: " + name);
+    }
+    expr->solve(parent_ref(), value);
+  }
+
+  /*
+   * Returns true and counts a hit, if the size is memoized.
+   * */
+  bool size_cache_hit() {
+    if (cached_size) {
+      size_cache_stats.hits++;
+      return true;
+    }
+    size_cache_stats.misses++;
+    return false;
+  }
+
+  /*
+   * Memoizes the size at the end of parse, if the sizes of all children are
+   * memoized, so the offsets recorded below are current right away.
+   * */
+  void memoize_size() {
+    bool memoized = true;
+    for_each_child(
+        [&](Base &child) { memoized = memoized && child.size_memoized(); });
+    if (memoized) {
+      get_size();
+    }
+  }
+
 public:
-  virtual void set_parent(std::weak_ptr<Base> parent) { this->parent = parent; }
+  virtual void set_parent(Base *parent) { this->parent = parent; }
   virtual void set_name(std::string name) { this->name = name; }
   virtual void set_idx(size_t idx) { this->idx = idx; }
 
   virtual std::vector<std::string> get_names() { return {name}; }
 
   Base(PrivateBase) {}
-  virtual std::any parse(std::istream &stream) = 0;
-  virtual void build(std::iostream &stream) = 0;
+
+  /*
+   * Returns a new, unparsed object with the same schema. Children are cloned
+   * as well, parsed data is not copied.
+   * */
+  virtual std::shared_ptr<Base> clone() const {
+    throw cpptrace::runtime_error("clone: Not implemented name: " + name);
+  }
+  virtual std::any parse(InputCursor &cursor) = 0;
+  virtual void build(OutputCursor &cursor) = 0;
+
+  /*
+   * Parses without returning the data, it is only kept in the tree. This
+   * saves collecting the results of all children in std::any maps and
+   * vectors, which parse has to do.
+   * */
+  void parse_tree(InputCursor &cursor) {
+    bool previous = collect_results;
+    collect_results = false;
+    try {
+      parse(cursor);
+    } catch (...) {
+      collect_results = previous;
+      throw;
+    }
+    collect_results = previous;
+  }
+
+  /*
+   * Parses without throwing on malformed data, the ParseError tells where
+   * parsing failed. Other errors, like bugs in callbacks, are returned as
+   * ParseErrors as well.
+   * */
+  std::expected<std::any, ParseError> try_parse(InputCursor &cursor) {
+    try {
+      return parse(cursor);
+    } catch (PathFailure &e) {
+      return std::unexpected(std::move(e.error));
+    } catch (std::exception &e) {
+      return std::unexpected(ParseError{{}, cursor.tell(), e.what()});
+    }
+  }
+
+  /*
+   * Parses from a std::istream.
+   *
+   * Pointers use absolute offsets, so the whole stream is read into memory
+   * once and parsed with an InputCursor starting at the current read position.
+   * Afterwards the stream is positioned behind the parsed data.
+   * */
+  std::any parse(std::istream &stream) {
+    int64_t start = stream.tellg();
+    custom_assert(start >= 0);
+    stream.seekg(0, std::ios_base::end);
+    int64_t end = stream.tellg();
+    stream.seekg(0, std::ios_base::beg);
+    std::vector<std::byte> buffer(end);
+    stream.read(reinterpret_cast<char *>(buffer.data()), end);
+    // owned by the cursor, as a LazyArray keeps reading from it
+    InputCursor cursor(std::make_shared<BufferSource>(std::move(buffer)), start);
+    auto ret = parse(cursor);
+    stream.seekg(cursor.tell());
+    return ret;
+  }
+
+  /*
+   * Builds into a std::ostream.
+   *
+   * Pointers use absolute offsets, so the data is built with an OutputCursor
+   * starting at the current write position, which writes to the stream
+   * through a StreamSink. Nothing in front of the position is buffered or
+   * overwritten. Like parse, the stream is positioned behind the built data,
+   * Pointer and Area data behind that is written as well.
+   * */
+  void build(std::ostream &stream) {
+    int64_t start = stream.tellp();
+    custom_assert(start >= 0);
+    OutputCursor cursor(std::make_shared<StreamSink>(stream), 64 * 1024);
+    cursor.seek(start);
+    build(cursor);
+    cursor.flush();
+    stream.seekp(cursor.tell());
+  }
 
   /*
    * Returns true if the object is a struct
@@ -64,6 +298,37 @@ public:
    * */
   virtual size_t get_size() = 0;
 
+  /*
+   * Returns true, if get_size does not need to recompute anything, i.e. the
+   * size is fixed or memoized. Containers only memoize their size, if this is
+   * true for all of their children.
+   * */
+  virtual bool size_memoized() { return cached_size.has_value(); }
+
+  /*
+   * Returns the size, if the object has a static size and layout, i.e. it is
+   * always parsed from and built into that many bytes without looking at
+   * other fields. Structs parse and build runs of such fields with a single
+   * bulk copy through parse_fixed and build_fixed.
+   * */
+  virtual std::optional<size_t> fixed_size() { return std::nullopt; }
+  bool is_fixed_layout() { return fixed_size().has_value(); }
+
+  /*
+   * Only for fixed layout objects, parses from the fixed_size bytes at data,
+   * which start at the given absolute offset.
+   * */
+  virtual std::any parse_fixed(const std::byte *, size_t) {
+    throw cpptrace::runtime_error("parse_fixed: Not implemented name: " + name);
+  }
+  /*
+   * Only for fixed layout objects, builds into the fixed_size bytes at data,
+   * which start at the given absolute offset.
+   * */
+  virtual void build_fixed(std::byte *, size_t) {
+    throw cpptrace::runtime_error("build_fixed: Not implemented name: " + name);
+  }
+
   /*
    * Only for Pointers, returns the offset of the pointer data.
    * */
@@ -82,6 +347,24 @@ public:
                                   " idx: " + std::to_string(idx));
   }
 
+  /*
+   * Returns false, if the object stores the values of its fields itself
+   * instead of in child nodes. get_field does not work then, get(key) does.
+   * */
+  virtual bool has_field_nodes() { return true; }
+
+  /*
+   * Returns the key paths of the fields the expressions of this object read,
+   * relative to its parent. See Expr.
+   * */
+  virtual std::vector<std::vector<std::string>> dependencies() { return {}; }
+
+  /*
+   * Calls fn for every child build writes, in that order. Only the current
+   * branch of an IfThenElse or a Switch is a child.
+   * */
+  virtual void for_each_child(const std::function<void(Base &)> &) {}
+
   /*
    * Returns the child field itself. Used for modifying the fields in test
    * cases.
@@ -102,6 +385,75 @@ public:
   template <typename T> std::weak_ptr<T> get_field(size_t key) {
     return static_pointer_cast<T>(get_field(key));
   }
+
+  // index of the parent in field_index
+  static constexpr size_t parent_index = SIZE_MAX;
+
+  /*
+   * Returns the index of the child key, which get_field_at returns without
+   * looking up the key. "_" is parent_index. Empty if the key is unknown or
+   * the child depends on the parsed data, like the case of a Switch.
+   * */
+  virtual std::optional<size_t> field_index(std::string_view) {
+    return std::nullopt;
+  }
+  virtual Base *get_field_at(size_t index) {
+    throw cpptrace::runtime_error("get_field_at(" + std::to_string(index) +
+                                  "): Not implemented name: " + name +
+                                  " idx: " + std::to_string(idx));
+  }
+
+  /*
+   * Resolves a path of keys below this object into indices, empty if a key
+   * can not be resolved.
+   * */
+  std::optional<ResolvedPath>
+  resolve_path(std::span<const std::string_view> keys) {
+    ResolvedPath ret;
+    Base *node = this;
+    for (auto key : keys) {
+      auto index = node->field_index(key);
+      if (!index) {
+        return std::nullopt;
+      }
+      node = node->get_field_at(index.value());
+      if (!node) {
+        return std::nullopt;
+      }
+      ret.push_back(index.value());
+    }
+    return ret;
+  }
+
+  /*
+   * Returns the field at the key path, resolving the path only on the first
+   * call. Returns nullptr if the path can not be resolved into indices.
+   * */
+  Base *cached_path(std::span<const std::string_view> path) {
+    for (auto &[cached, resolved] : path_cache) {
+      if (std::equal(cached.begin(), cached.end(), path.begin(), path.end())) {
+        return resolved ? follow_path(resolved.value()) : nullptr;
+      }
+    }
+    auto resolved = resolve_path(path);
+    if (path_cache.size() < max_cached_paths) {
+      path_cache.emplace_back(std::vector<std::string>(path.begin(), path.end()),
+                              resolved);
+    }
+    return resolved ? follow_path(resolved.value()) : nullptr;
+  }
+
+  /*
+   * Returns the field at a resolved path, in O(depth) without any lookups.
+   * */
+  Base *follow_path(const ResolvedPath &path) {
+    Base *node = this;
+    for (auto index : path) {
+      node = node->get_field_at(index);
+    }
+    return node;
+  }
+
   template <typename T, typename K, typename... Ts>
   std::weak_ptr<T> get_field(K key, Ts &&...args) {
     std::weak_ptr<Base> field = get_field(key);
@@ -112,6 +464,34 @@ public:
     }
   }
 
+  /*
+   * Returns a view of the value of simple objects, empty otherwise.
+   * */
+  virtual ValueView value_view() { return {}; }
+
+  /*
+   * Like get, but reads the value through value_view without boxing it in a
+   * std::any, if possible.
+   * */
+  template <typename T> T get_as() {
+    if constexpr (variant_has<const T *, ValueView>::value) {
+      auto view = value_view();
+      if (auto value = std::get_if<const T *>(&view)) {
+        return **value;
+      }
+    }
+    return get<T>();
+  }
+  template <typename T, typename K, typename... Ts>
+  T get_as(K key, Ts &&...args) {
+    if constexpr (sizeof...(Ts) == 0) {
+      if (!has_field_nodes()) {
+        return get<T>(key);
+      }
+    }
+    return lock(get_field(key))->template get_as<T>(args...);
+  }
+
   // returns all the data
   virtual std::any get() = 0;
   template <typename T> T get() { return std::any_cast<T>(get()); }
@@ -128,6 +508,20 @@ public:
   };
   template <typename T> T get(size_t key) { return std::any_cast<T>(get(key)); }
   template <typename T, typename K, typename... Ts> T get(K key, Ts &&...args) {
+    if constexpr (sizeof...(Ts) == 0 && std::is_integral_v<K>) {
+      // array elements are read directly, NumberArray has no element nodes
+      return std::any_cast<T>(get(static_cast<size_t>(key)));
+    } else if constexpr (sizeof...(Ts) == 0) {
+      if (!has_field_nodes()) {
+        return std::any_cast<T>(get(std::string(key)));
+      }
+    }
+    if constexpr ((std::is_convertible_v<K, std::string_view> && ... &&
+                   std::is_convertible_v<Ts, std::string_view>)) {
+      if (auto field = cached_field(key, args...)) {
+        return field->template get_as<T>();
+      }
+    }
     std::weak_ptr<Base> field = get_field(key);
     // spdlog::warn("get: {} {} {}", key, lock(field)->name, lock(field)->idx);
     return lock(field)->get<T>(args...);
@@ -153,12 +547,22 @@ public:
     return lock(field)->get_parsed<T>(args...);
   }
 
+  /*
+   * Returns the absolute offset of the object.
+   *
+   * parse and build record the offset of every node they visit, so this is
+   * O(1) afterwards, as long as offset_current holds. Otherwise the offset is
+   * computed from the parent.
+   * */
   virtual size_t get_offset() {
-    if (parent.lock()) {
-      if (lock(parent)->is_array()) {
-        return lock(parent)->get_offset(idx);
-      } else if (lock(parent)->is_struct()) {
-        return lock(parent)->get_offset(name);
+    if (offset_current()) {
+      return cached_offset.value();
+    }
+    if (parent) {
+      if (parent->is_array()) {
+        return parent->get_offset(idx);
+      } else if (parent->is_struct()) {
+        return parent->get_offset(name);
       }
       throw cpptrace::runtime_error("Base: parent is not array or struct!");
     }
@@ -176,13 +580,71 @@ public:
     return lock(field)->get_offset(key2, args...);
   }
 
+  /*
+   * Returns true, if the offset was recorded by parse or build.
+   * */
+  bool has_offset() { return cached_offset.has_value(); }
+
+  /*
+   * Returns true, if the recorded offset can be trusted. Fields like leaf
+   * strings can be assigned directly, without size_changed, so it only holds
+   * if the sizes of all containers above are memoized, which they are not if
+   * such fields are inside. Pointers and Areas place their children on their
+   * own, so the containers above them do not matter.
+   * */
+  bool offset_current() {
+    if (!cached_offset) {
+      return false;
+    }
+    for (Base *p = parent; p && !p->is_pointer_type(); p = p->parent) {
+      if ((p->is_struct() || p->is_array()) && !p->size_memoized()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*
+   * Drops the recorded offset of this object and all objects below it.
+   * */
+  virtual void invalidate_offset() { cached_offset.reset(); }
+
+  /*
+   * Drops the recorded offsets of all children behind the given one.
+   * */
+  virtual void invalidate_offsets_after(std::string) {
+    throw cpptrace::runtime_error("Not implemented");
+  }
+  virtual void invalidate_offsets_after(size_t) {
+    throw cpptrace::runtime_error("Not implemented");
+  }
+
+  /*
+   * Has to be called when the size of the object changed after parsing, e.g.
+   * when set assigns a longer value. The memoized sizes of the object
+   * and its parents are dropped, and everything behind the object moves, so
+   * their recorded offsets are dropped as well.
+   * */
+  void size_changed() {
+    cached_size.reset();
+    auto p = parent;
+    if (!p) {
+      return;
+    }
+    if (p->is_array()) {
+      p->invalidate_offsets_after(idx);
+    } else if (p->is_struct()) {
+      p->invalidate_offsets_after(name);
+    } else if (!p->is_pointer_type()) {
+      p->invalidate_offset();
+      p->size_changed();
+    }
+  }
+
   std::vector<char> get_bytes() {
-    std::vector<char> ret;
-    ret.resize(get_size());
-    std::stringstream ss;
-    build(ss);
-    ss.read(ret.data(), ret.size());
-    return ret;
+    OutputCursor cursor(get_size());
+    build(cursor);
+    return cursor.release();
   }
 
   virtual void set(std::any) {
@@ -206,30 +668,554 @@ public:
   }
 };
 
+/*
+ * A handle to a field like "header/count" or "_/size", for size and offset
+ * functions. The path is resolved into child indices at the first node it is
+ * used on, afterwards it is followed without looking up any keys. It must
+ * always be used on nodes at the same place of the same schema.
+ * */
+class FieldPath {
+  std::vector<std::string> keys;
+  bool resolved = false;
+  // path to the parent of the last key and index of the last key, if they
+  // can be resolved
+  std::optional<ResolvedPath> parent_path;
+  std::optional<size_t> last_index;
+
+  Base *parent_of_last(const std::weak_ptr<Base> &from) {
+    Base *node = lock(from).get();
+    if (!resolved) {
+      std::vector<std::string_view> path(keys.begin(), keys.end() - 1);
+      parent_path = node->resolve_path(path);
+    }
+    if (parent_path) {
+      node = node->follow_path(parent_path.value());
+    } else {
+      for (size_t i = 0; i + 1 < keys.size(); i++) {
+        node = lock(node->get_field(keys[i])).get();
+      }
+    }
+    if (!resolved) {
+      if (parent_path) {
+        last_index = node->field_index(keys.back());
+      }
+      resolved = true;
+    }
+    return node;
+  }
+
+public:
+  FieldPath(std::string_view path) {
+    size_t start = 0;
+    while (true) {
+      size_t end = path.find('/', start);
+      keys.emplace_back(path.substr(start, end - start));
+      if (end == std::string_view::npos) {
+        break;
+      }
+      start = end + 1;
+    }
+  }
+  FieldPath(std::initializer_list<std::string> keys) : keys(keys) {}
+
+  std::shared_ptr<Base> field(const std::weak_ptr<Base> &from) {
+    auto parent = parent_of_last(from);
+    if (last_index) {
+      return parent->get_field_at(last_index.value())->shared_from_this();
+    }
+    return lock(parent->get_field(keys.back()));
+  }
+
+  template <typename T> T get(const std::weak_ptr<Base> &from) {
+    auto parent = parent_of_last(from);
+    if (last_index) {
+      return parent->get_field_at(last_index.value())->template get_as<T>();
+    }
+    if (!parent->has_field_nodes()) {
+      return parent->template get<T>(keys.back());
+    }
+    return lock(parent->get_field(keys.back()))->template get_as<T>();
+  }
+};
+
+/*
+ * Converts a numeric value to int64_t, empty if it is not a number.
+ * */
+inline std::optional<int64_t> to_integer(const ValueView &view) {
+  return std::visit(
+      [](auto value) -> std::optional<int64_t> {
+        if constexpr (std::is_same_v<decltype(value), std::monostate>) {
+          return std::nullopt;
+        } else if constexpr (!std::is_arithmetic_v<
+                                 std::remove_cvref_t<decltype(*value)>>) {
+          return std::nullopt;
+        } else {
+          return static_cast<int64_t>(*value);
+        }
+      },
+      view);
+}
+template <typename... Ts>
+inline std::optional<int64_t> any_to_integer(const std::any &value) {
+  std::optional<int64_t> ret;
+  ((value.type() == typeid(Ts)
+        ? (ret = static_cast<int64_t>(std::any_cast<Ts>(value)), true)
+        : false) ||
+   ...);
+  return ret;
+}
+inline int64_t to_integer(const std::any &value) {
+  auto ret = any_to_integer<int8_t, uint8_t, int16_t, uint16_t, int32_t,
+                            uint32_t, int64_t, uint64_t, float, double, bool>(
+      value);
+  if (!ret) {
+    throw cpptrace::runtime_error("Expr: field is not a number");
+  }
+  return ret.value();
+}
+
+/*
+ * Sets the value of a number object from an int64_t, converted to its type.
+ * */
+inline void set_integer(Base &node, int64_t value) {
+  std::visit(
+      [&](auto view) {
+        if constexpr (std::is_same_v<decltype(view), std::monostate>) {
+          throw cpptrace::runtime_error("set_integer: not a number");
+        } else {
+          using T = std::remove_cvref_t<decltype(*view)>;
+          if constexpr (!std::is_arithmetic_v<T>) {
+            throw cpptrace::runtime_error("set_integer: not a number");
+          } else {
+            node.set(static_cast<T>(value));
+          }
+        }
+      },
+      node.value_view());
+}
+
+/*
+ * A declarative expression for sizes, offsets and conditions, e.g.
+ *
+ *   using namespace etcetera::expr;
+ *   Array::create(this_["count"] * 2, ...);
+ *   Pointer::create(parent["header"]["offset"] + 4, ...);
+ *   IfThenElse::create(this_["flags"] & 1, ...);
+ *
+ * this_ refers to the object the expression is evaluated for, the parent of
+ * the node using it, like the argument of the lambdas. Expressions convert to
+ * the std::function callbacks of all nodes, so lambdas keep working for the
+ * custom cases. Unlike lambdas they can be inspected: expr_of returns the
+ * expression behind a callback, constant() its value if it does not read any
+ * fields and fields() the fields it reads.
+ *
+ * Field references are resolved with Base::cached_path, so evaluating them
+ * does not hash any keys and numbers are read without std::any.
+ * */
+class Expr {
+public:
+  enum class Op : uint8_t {
+    Constant,
+    Field,
+    Neg,
+    Not,
+    BitNot,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Mod,
+    BitAnd,
+    BitOr,
+    BitXor,
+    Shl,
+    Shr,
+    Eq,
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    And,
+    Or,
+  };
+
+protected:
+  struct Node {
+    Op op;
+    int64_t value = 0;
+    std::vector<std::string> keys;
+    // views of keys, for Base::cached_path
+    std::vector<std::string_view> path;
+    std::shared_ptr<const Node> lhs, rhs;
+
+    Node(Op op, int64_t value) : op(op), value(value) {}
+    Node(std::vector<std::string> keys)
+        : op(Op::Field), keys(std::move(keys)),
+          path(this->keys.begin(), this->keys.end()) {}
+    Node(Op op, std::shared_ptr<const Node> lhs,
+         std::shared_ptr<const Node> rhs = nullptr)
+        : op(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+    Node(const Node &) = delete;
+    Node &operator=(const Node &) = delete;
+  };
+  std::shared_ptr<const Node> node;
+
+  Expr(std::shared_ptr<const Node> node) : node(std::move(node)) {}
+
+  /*
+   * Applies op to a and b. Arithmetic wraps around like on unsigned values.
+   * Operations which are undefined on int64_t, like shifting by 64 or more
+   * or dividing INT64_MIN by -1, throw a ParseFailure at the offset of
+   * context, if it is known.
+   * */
+  static int64_t apply(Op op, int64_t a, int64_t b, Base *context = nullptr) {
+    auto fail = [&](std::string reason) {
+      size_t offset =
+          context && context->offset_current() ? context->get_offset() : 0;
+      throw ParseFailure(offset, "Expr: " + reason);
+    };
+    auto ua = static_cast<uint64_t>(a);
+    auto ub = static_cast<uint64_t>(b);
+    switch (op) {
+    case Op::Neg:
+      return static_cast<int64_t>(0 - ua);
+    case Op::Not:
+      return !a;
+    case Op::BitNot:
+      return ~a;
+    case Op::Add:
+      return static_cast<int64_t>(ua + ub);
+    case Op::Sub:
+      return static_cast<int64_t>(ua - ub);
+    case Op::Mul:
+      return static_cast<int64_t>(ua * ub);
+    case Op::Div:
+    case Op::Mod:
+      if (b == 0) {
+        fail("division by zero");
+      }
+      if (a == std::numeric_limits<int64_t>::min() && b == -1) {
+        fail("division of " + std::to_string(a) + " by -1 overflows");
+      }
+      return op == Op::Div ? a / b : a % b;
+    case Op::BitAnd:
+      return a & b;
+    case Op::BitOr:
+      return a | b;
+    case Op::BitXor:
+      return a ^ b;
+    case Op::Shl:
+    case Op::Shr:
+      if (b < 0 || b >= 64) {
+        fail("shift by " + std::to_string(b));
+      }
+      return op == Op::Shl ? a << b : a >> b;
+    case Op::Eq:
+      return a == b;
+    case Op::Ne:
+      return a != b;
+    case Op::Lt:
+      return a < b;
+    case Op::Le:
+      return a <= b;
+    case Op::Gt:
+      return a > b;
+    case Op::Ge:
+      return a >= b;
+    case Op::And:
+      return a && b;
+    case Op::Or:
+      return a || b;
+    default:
+      throw cpptrace::runtime_error("Expr: invalid operator");
+    }
+  }
+
+  static int64_t read_field(const Node &n, Base &context) {
+    if (auto field = context.cached_path(n.path)) {
+      if (auto value = to_integer(field->value_view())) {
+        return value.value();
+      }
+      return to_integer(field->get());
+    }
+    // not resolvable by index, e.g. through a Switch
+    auto node = context.shared_from_this();
+    for (size_t i = 0; i + 1 < n.keys.size(); i++) {
+      node = lock(node->get_field(n.keys[i]));
+    }
+    if (!node->has_field_nodes()) {
+      return to_integer(node->get(n.keys.back()));
+    }
+    return to_integer(lock(node->get_field(n.keys.back()))->get());
+  }
+
+  static int64_t evaluate(const Node &n, Base &context) {
+    switch (n.op) {
+    case Op::Constant:
+      return n.value;
+    case Op::Field:
+      return read_field(n, context);
+    case Op::And:
+      return evaluate(*n.lhs, context) && evaluate(*n.rhs, context);
+    case Op::Or:
+      return evaluate(*n.lhs, context) || evaluate(*n.rhs, context);
+    default:
+      return apply(n.op, evaluate(*n.lhs, context),
+                   n.rhs ? evaluate(*n.rhs, context) : 0, &context);
+    }
+  }
+
+  static void collect_fields(const Node &n,
+                             std::vector<std::vector<std::string>> &ret) {
+    if (n.op == Op::Field) {
+      ret.push_back(n.keys);
+    }
+    if (n.lhs) {
+      collect_fields(*n.lhs, ret);
+    }
+    if (n.rhs) {
+      collect_fields(*n.rhs, ret);
+    }
+  }
+
+  static Expr unary(Op op, const Expr &a) {
+    if (auto value = a.constant()) {
+      return apply(op, value.value(), 0);
+    }
+    return Expr(std::make_shared<const Node>(op, a.node));
+  }
+  static Expr binary(Op op, const Expr &a, const Expr &b) {
+    auto x = a.constant();
+    auto y = b.constant();
+    if (x && y) {
+      return apply(op, x.value(), y.value());
+    }
+    return Expr(std::make_shared<const Node>(op, a.node, b.node));
+  }
+
+public:
+  Expr(int64_t value) : node(std::make_shared<const Node>(Op::Constant, value)) {}
+
+  /*
+   * A reference to the field at the key path, relative to this_.
+   * */
+  static Expr field(std::vector<std::string> keys) {
+    return Expr(std::make_shared<const Node>(std::move(keys)));
+  }
+
+  Expr operator[](std::string key) const {
+    if (node->op != Op::Field) {
+      throw cpptrace::runtime_error("Expr: [" + key + "] of a non-field");
+    }
+    auto keys = node->keys;
+    keys.push_back(std::move(key));
+    return field(std::move(keys));
+  }
+
+  int64_t evaluate(Base &context) const {
+    if (auto value = constant()) {
+      return value.value();
+    }
+    return evaluate(*node, context);
+  }
+  int64_t operator()(const std::weak_ptr<Base> &context) const {
+    return evaluate(*lock(context));
+  }
+
+  /*
+   * Returns the value, if the expression does not read any fields.
+   * */
+  std::optional<int64_t> constant() const {
+    if (node->op == Op::Constant) {
+      return node->value;
+    }
+    return std::nullopt;
+  }
+
+  /*
+   * Sets the field of an expression like this_["offset"] + 16, so that it
+   * evaluates to value. Throws for other expressions and for constants with
+   * a different value.
+   * */
+  void solve(Base &context, int64_t value) const {
+    if (auto c = constant()) {
+      if (c.value() != value) {
+        throw cpptrace::runtime_error("Expr: constant " +
+                                      std::to_string(c.value()) + " is not " +
+                                      std::to_string(value));
+      }
+      return;
+    }
+    const Node *field = node.get();
+    if ((node->op == Op::Add || node->op == Op::Sub) &&
+        node->rhs->op == Op::Constant) {
+      field = node->lhs.get();
+      value += node->op == Op::Add ? -node->rhs->value : node->rhs->value;
+    } else if (node->op == Op::Add && node->lhs->op == Op::Constant) {
+      field = node->rhs.get();
+      value -= node->lhs->value;
+    }
+    if (field->op != Op::Field) {
+      throw cpptrace::runtime_error(
+          "Expr: only a field plus a constant can be solved");
+    }
+    Base *target = context.cached_path(field->path);
+    if (!target) {
+      auto current = context.shared_from_this();
+      for (auto &key : field->keys) {
+        current = lock(current->get_field(key));
+      }
+      target = current.get();
+    }
+    set_integer(*target, value);
+  }
+
+  /*
+   * Returns the key paths of all fields the expression reads.
+   * */
+  std::vector<std::vector<std::string>> fields() const {
+    std::vector<std::vector<std::string>> ret;
+    collect_fields(*node, ret);
+    return ret;
+  }
+
+  friend Expr operator-(const Expr &a) { return unary(Op::Neg, a); }
+  friend Expr operator!(const Expr &a) { return unary(Op::Not, a); }
+  friend Expr operator~(const Expr &a) { return unary(Op::BitNot, a); }
+  friend Expr operator+(const Expr &a, const Expr &b) {
+    return binary(Op::Add, a, b);
+  }
+  friend Expr operator-(const Expr &a, const Expr &b) {
+    return binary(Op::Sub, a, b);
+  }
+  friend Expr operator*(const Expr &a, const Expr &b) {
+    return binary(Op::Mul, a, b);
+  }
+  friend Expr operator/(const Expr &a, const Expr &b) {
+    return binary(Op::Div, a, b);
+  }
+  friend Expr operator%(const Expr &a, const Expr &b) {
+    return binary(Op::Mod, a, b);
+  }
+  friend Expr operator&(const Expr &a, const Expr &b) {
+    return binary(Op::BitAnd, a, b);
+  }
+  friend Expr operator|(const Expr &a, const Expr &b) {
+    return binary(Op::BitOr, a, b);
+  }
+  friend Expr operator^(const Expr &a, const Expr &b) {
+    return binary(Op::BitXor, a, b);
+  }
+  friend Expr operator<<(const Expr &a, const Expr &b) {
+    return binary(Op::Shl, a, b);
+  }
+  friend Expr operator>>(const Expr &a, const Expr &b) {
+    return binary(Op::Shr, a, b);
+  }
+  friend Expr operator==(const Expr &a, const Expr &b) {
+    return binary(Op::Eq, a, b);
+  }
+  friend Expr operator!=(const Expr &a, const Expr &b) {
+    return binary(Op::Ne, a, b);
+  }
+  friend Expr operator<(const Expr &a, const Expr &b) {
+    return binary(Op::Lt, a, b);
+  }
+  friend Expr operator<=(const Expr &a, const Expr &b) {
+    return binary(Op::Le, a, b);
+  }
+  friend Expr operator>(const Expr &a, const Expr &b) {
+    return binary(Op::Gt, a, b);
+  }
+  friend Expr operator>=(const Expr &a, const Expr &b) {
+    return binary(Op::Ge, a, b);
+  }
+  friend Expr operator&&(const Expr &a, const Expr &b) {
+    return binary(Op::And, a, b);
+  }
+  friend Expr operator||(const Expr &a, const Expr &b) {
+    return binary(Op::Or, a, b);
+  }
+};
+
+namespace expr {
+// the object an expression is evaluated for
+inline const Expr this_ = Expr::field({});
+// the parent of this_
+inline const Expr parent = Expr::field({"_"});
+} // namespace expr
+
+/*
+ * Returns the expression behind a callback, nullptr if it is a lambda.
+ * */
+template <typename F> const Expr *expr_of(const F &fn) {
+  return fn ? fn.template target<Expr>() : nullptr;
+}
+
+/*
+ * Returns the value of a callback, if it is a constant expression.
+ * */
+template <typename F> inline std::optional<int64_t> constant_of(const F &fn) {
+  auto e = expr_of(fn);
+  return e ? e->constant() : std::nullopt;
+}
+
+/*
+ * Returns the fields a callback reads, if it is an expression.
+ * */
+template <typename F>
+inline std::vector<std::vector<std::string>> fields_of(const F &fn) {
+  auto e = expr_of(fn);
+  return e ? e->fields() : std::vector<std::vector<std::string>>();
+}
+
 template <typename T> class Const : public Base {
 public:
   using Base::get;
   using Base::get_field;
   using Base::get_offset;
+  using Base::parse;
+  using Base::build;
   T value;
   Const(T val, PrivateBase) : Base(PrivateBase()), value(val) {}
   static std::shared_ptr<Const> create(T val) {
-    return std::make_shared<Const>(val, PrivateBase());
+    return make_node<Const>(val, PrivateBase());
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    return make_node<Const>(*this);
   }
 
   std::any get() override { return value; }
+  ValueView value_view() override { return make_value_view(value); }
 
   bool is_simple_type() override { return true; }
 
   size_t get_size() override { return sizeof(T); }
+  bool size_memoized() override { return true; }
+  std::optional<size_t> fixed_size() override { return sizeof(T); }
 
-  std::any parse(std::istream &stream) override {
-    stream.read(reinterpret_cast<char *>(&value), sizeof(T));
-    return value;
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    cursor.read(&value, sizeof(T));
+    return result(value);
   }
 
-  void build(std::iostream &stream) override {
-    stream.write(reinterpret_cast<char *>(&value), sizeof(T));
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    cursor.write(&value, sizeof(T));
+  }
+
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    std::memcpy(&value, data, sizeof(T));
+    return result(value);
+  }
+
+  void build_fixed(std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    std::memcpy(data, &value, sizeof(T));
   }
 
   void parse_xml(pugi::xml_node const &, std::string, bool) override {}
@@ -247,31 +1233,53 @@ public:
   using Base::get;
   using Base::get_field;
   using Base::get_offset;
+  using Base::parse;
+  using Base::build;
   BytesConst(std::string val, PrivateBase) : Base(PrivateBase()), value(val) {}
   static std::shared_ptr<BytesConst> create(const std::string &val) {
-    return std::make_shared<BytesConst>(val, PrivateBase());
+    return make_node<BytesConst>(val, PrivateBase());
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    return make_node<BytesConst>(*this);
   }
 
   bool is_simple_type() override { return true; }
 
   std::any get() override { return value; }
+  ValueView value_view() override { return make_value_view(value); }
 
   size_t get_size() override { return value.length(); }
+  bool size_memoized() override { return true; }
+  std::optional<size_t> fixed_size() override { return value.length(); }
+
+  std::any parse(InputCursor &cursor) override {
+    auto bytes = cursor.read(value.length());
+    return parse_fixed(bytes.data(), cursor.tell() - bytes.size());
+  }
+
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    cursor.write(value.data(), value.length());
+  }
 
-  std::any parse(std::istream &stream) override {
-    std::string tmp;
-    tmp.resize(value.length());
-    stream.read(reinterpret_cast<char *>(tmp.data()), tmp.length());
-    if (tmp != value) {
-      throw cpptrace::runtime_error("BytesConst @" +
-                                    std::to_string(stream.tellg()) +
-                                    ": expected " + value + ", got " + tmp);
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    // data may be null for an empty constant, which memcmp doesn't allow
+    if (value.length() != 0 &&
+        std::memcmp(data, value.data(), value.length()) != 0) {
+      std::string tmp(reinterpret_cast<const char *>(data), value.length());
+      throw ParseFailure(offset, "BytesConst: expected " + value + ", got " +
+                                     tmp);
     }
-    return value;
+    return result(value);
   }
 
-  void build(std::iostream &stream) override {
-    stream.write(value.data(), value.length());
+  void build_fixed(std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    if (value.length() != 0) {
+      std::memcpy(data, value.data(), value.length());
+    }
   }
 
   void parse_xml(pugi::xml_node const &, std::string, bool) override {}
@@ -291,48 +1299,85 @@ public:
   using Base::get;
   using Base::get_field;
   using Base::get_offset;
+  using Base::parse;
+  using Base::build;
   std::vector<uint8_t> value;
   Bytes(PrivateBase, FSizeFn size_fn, size_t size)
       : Base(PrivateBase()), size_fn(size_fn), size(size) {
     value.resize(size);
   }
   static std::shared_ptr<Bytes> create(size_t s) {
-    return std::make_shared<Bytes>(PrivateBase(), nullptr, s);
+    return make_node<Bytes>(PrivateBase(), nullptr, s);
   }
   static std::shared_ptr<Bytes> create(FSizeFn size_fn) {
-    return std::make_shared<Bytes>(PrivateBase(), size_fn, 0);
+    if (auto size = constant_of(size_fn)) {
+      return create(size.value());
+    }
+    return make_node<Bytes>(PrivateBase(), size_fn, 0);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    return make_node<Bytes>(*this);
   }
 
   bool is_simple_type() override { return true; }
 
   std::any get() override { return value; }
+  ValueView value_view() override { return make_value_view(value); }
 
   size_t get_size() override {
     if (size_fn) {
-      size = size_fn(this->parent);
+      size = call(size_fn);
     }
     return size;
   }
+  bool size_memoized() override { return !size_fn; }
+  std::optional<size_t> fixed_size() override {
+    if (size_fn) {
+      return std::nullopt;
+    }
+    return size;
+  }
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(size_fn);
+  }
 
-  std::any parse(std::istream &stream) override {
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Bytes::parse", name, idx, cursor);
     get_size();
     value.resize(size);
-
-    spdlog::debug("Bytes {:02X} {} read", (size_t)stream.tellg(), value.size());
-    stream.read(reinterpret_cast<char *>(value.data()), value.size());
+    cursor.read(value.data(), value.size());
 
     //std::string s;
     //for (auto &c : value) {
     //  s += std::format("{:02X}", static_cast<uint8_t>(c));
     //}
-    return value;
+    return result(value);
   }
 
-  void build(std::iostream &stream) override {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Bytes::build", name, idx, cursor);
     custom_assert(value.size() == size);
-    spdlog::debug("Bytes {:02X} {} write", (size_t)stream.tellp(),
-                  value.size());
-    stream.write(reinterpret_cast<char *>(value.data()), value.size());
+    cursor.write(value.data(), value.size());
+  }
+
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    value.resize(size);
+    if (size != 0) {
+      std::memcpy(value.data(), data, size);
+    }
+    return result(value);
+  }
+
+  void build_fixed(std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    custom_assert(value.size() == size);
+    if (size != 0) {
+      std::memcpy(data, value.data(), size);
+    }
   }
 
   void parse_xml(pugi::xml_node const &node, std::string name, bool) override {
@@ -365,35 +1410,63 @@ public:
 
 class Padding : public Bytes {
 public:
+  using Base::parse;
+  using Base::build;
   Padding(PrivateBase, FSizeFn size_fn, size_t size)
   : Bytes(PrivateBase(), size_fn, size){
   }
   static std::shared_ptr<Padding> create(size_t s) {
-    return std::make_shared<Padding>(PrivateBase(), nullptr, s);
+    return make_node<Padding>(PrivateBase(), nullptr, s);
   }
   static std::shared_ptr<Padding> create(FSizeFn size_fn) {
-    return std::make_shared<Padding>(PrivateBase(), size_fn, 0);
+    if (auto size = constant_of(size_fn)) {
+      return create(size.value());
+    }
+    return make_node<Padding>(PrivateBase(), size_fn, 0);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    return make_node<Padding>(*this);
   }
-  std::any parse(std::istream &stream) override {
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Padding::parse", name, idx, cursor);
     get_size();
     value.resize(size);
-
-    spdlog::debug("Padding {:02X} {} read", (size_t)stream.tellg(), value.size());
-    stream.read(reinterpret_cast<char *>(value.data()), value.size());
+    cursor.read(value.data(), value.size());
 
     for(auto &c : value) {
       if (c != 0) {
-        throw cpptrace::runtime_error("Padding: expected 0, got " + std::to_string(c));
+        throw ParseFailure(cursor.tell(), "Padding: expected 0");
       }
     }
 
-    return value;
+    return result(value);
   }
 
-  void build(std::iostream &stream) override {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
     value.resize(size);
     std::fill(value.begin(), value.end(), 0);
-    stream.write(reinterpret_cast<char *>(value.data()), value.size());
+    cursor.write(value.data(), value.size());
+  }
+
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    Bytes::parse_fixed(data, offset);
+    for (auto &c : value) {
+      if (c != 0) {
+        throw ParseFailure(offset, "Padding: expected 0");
+      }
+    }
+    return result(value);
+  }
+
+  void build_fixed(std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    value.assign(size, 0);
+    if (size != 0) {
+      std::memset(data, 0, size);
+    }
   }
 
   void parse_xml(pugi::xml_node const &, std::string , bool) override {
@@ -411,6 +1484,8 @@ public:
   using Base::get;
   using Base::get_field;
   using Base::get_offset;
+  using Base::parse;
+  using Base::build;
 
   T value;
   typedef std::pair<std::string, T> Field;
@@ -424,45 +1499,44 @@ public:
   }
   template <typename... Args>
   static std::shared_ptr<Enum> create(Args &&...args) {
-    return std::make_shared<Enum>(PrivateBase(), args...);
+    return make_node<Enum>(PrivateBase(), args...);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    return make_node<Enum>(*this);
   }
 
   bool is_simple_type() override { return true; }
 
   std::any get() override { return value; }
+  ValueView value_view() override { return make_value_view(value); }
 
   size_t get_size() override { return sizeof(T); }
+  bool size_memoized() override { return true; }
+  std::optional<size_t> fixed_size() override { return sizeof(T); }
 
-  std::any parse(std::istream &stream) override {
-    stream.read(reinterpret_cast<char *>(&value), sizeof(value));
-    if constexpr (Endianess != std::endian::native) {
-      union {
-        T value;
-        char bytes[sizeof(T)];
-      } bswap;
-      bswap.value = value;
-      for (size_t i = 0; i < sizeof(T) / 2; i++) {
-        std::swap(bswap.bytes[i], bswap.bytes[sizeof(T) - i - 1]);
-      }
-      value = bswap.value;
-    }
-    return value;
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    value = cursor.read<T, Endianess>();
+    return result(value);
   }
 
-  void build(std::iostream &stream) override {
-    auto val = value;
-    if constexpr (Endianess != std::endian::native) {
-      union {
-        T value;
-        char bytes[sizeof(T)];
-      } bswap;
-      bswap.value = value;
-      for (size_t i = 0; i < sizeof(T) / 2; i++) {
-        std::swap(bswap.bytes[i], bswap.bytes[sizeof(T) - i - 1]);
-      }
-      val = bswap.value;
-    }
-    stream.write(reinterpret_cast<char *>(&val), sizeof(val));
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    cursor.write<T, Endianess>(value);
+  }
+
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    std::memcpy(&value, data, sizeof(T));
+    value = swap_endian<Endianess>(value);
+    return result(value);
+  }
+
+  void build_fixed(std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    T v = swap_endian<Endianess>(value);
+    std::memcpy(data, &v, sizeof(T));
   }
 
   void parse_xml(pugi::xml_node const &node, std::string name, bool) override {
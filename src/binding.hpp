@@ -0,0 +1,80 @@
+#pragma once
+
+#include "static.hpp"
+
+#include <span>
+#include <vector>
+
+namespace etcetera {
+
+/*
+ * Bindings parse into and build from plain C++ structs, without any nodes.
+ *
+ *   struct Header {
+ *     uint32_t magic;
+ *     uint16_t count;
+ *   };
+ *   using HeaderBinding =
+ *       Binding<Header, Bind<"magic", &Header::magic, Int32ul>,
+ *               Bind<"count", &Header::count, Int16ub>>;
+ *
+ * The fields are listed in file order, every one maps a member to a type tag
+ * of static.hpp. A Binding is a compile-time schema like StaticStruct, so it
+ * can be nested into StaticStructs and StaticArrays or put into a dynamic
+ * tree with Static<HeaderBinding>.
+ * */
+template <FixedString Name, auto Member, typename T> struct Bind {
+  static constexpr std::string_view name = Name.view();
+  typedef StaticCodec<T> codec;
+
+  template <size_t, typename TValue> static auto &access(TValue &value) {
+    static_assert(std::is_same_v<std::remove_cvref_t<decltype(value.*Member)>,
+                                 typename codec::value_type>,
+                  "Bind: member type does not match the field type");
+    return value.*Member;
+  }
+};
+
+template <typename T, typename... Fields>
+struct Binding : StaticRecord<T, Fields...> {
+  typedef StaticRecord<T, Fields...> record;
+
+  /*
+   * Parses count records in a row. Fixed size records are read with a single
+   * bounds check and decoded in place.
+   * */
+  static std::vector<T> parse_all(InputCursor &cursor, size_t count) {
+    std::vector<T> ret(count);
+    if constexpr (record::fixed) {
+      size_t offset = cursor.tell();
+      auto bytes = cursor.read(count * record::size);
+      for (size_t i = 0; i < count; i++) {
+        record::decode(bytes.data() + i * record::size,
+                       offset + i * record::size, ret[i]);
+      }
+    } else {
+      for (auto &value : ret) {
+        record::parse(cursor, value);
+      }
+    }
+    return ret;
+  }
+
+  /*
+   * Builds the records in a row.
+   * */
+  static void build_all(OutputCursor &cursor, std::span<const T> values) {
+    if constexpr (record::fixed) {
+      auto bytes = cursor.claim(values.size() * record::size);
+      for (size_t i = 0; i < values.size(); i++) {
+        record::encode(bytes.data() + i * record::size, values[i]);
+      }
+    } else {
+      for (auto &value : values) {
+        record::build(cursor, value);
+      }
+    }
+  }
+};
+
+} // namespace etcetera
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ETCETERA_BYTESWAP_X86 1
+#endif
+
+namespace etcetera {
+
+/*
+ * Bulk byteswap kernels, used by swap_endian_n for arrays of numbers.
+ *
+ * Every kernel reverses the bytes of n values of Size bytes in place. The
+ * buffer does not need to be aligned. On x86 an SSSE3 or AVX2 kernel is
+ * picked at runtime, everything else uses the scalar kernel.
+ * */
+namespace byteswap {
+
+template <size_t Size> struct UInt;
+template <> struct UInt<2> { using type = uint16_t; };
+template <> struct UInt<4> { using type = uint32_t; };
+template <> struct UInt<8> { using type = uint64_t; };
+
+typedef void (*Kernel)(void *, size_t);
+
+template <size_t Size> inline void scalar(void *data, size_t n) {
+  using U = typename UInt<Size>::type;
+  auto p = static_cast<std::byte *>(data);
+  for (size_t i = 0; i < n; i++) {
+    U v;
+    std::memcpy(&v, p + i * Size, Size);
+    v = std::byteswap(v);
+    std::memcpy(p + i * Size, &v, Size);
+  }
+}
+
+#ifdef ETCETERA_BYTESWAP_X86
+
+// shuffle mask reversing every Size byte group of a 16 byte lane
+template <size_t Size>
+__attribute__((target("ssse3"))) inline __m128i shuffle_mask() {
+  alignas(16) int8_t mask[16];
+  for (size_t i = 0; i < 16; i++) {
+    mask[i] = static_cast<int8_t>(i - i % Size + Size - 1 - i % Size);
+  }
+  return _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+}
+
+template <size_t Size>
+__attribute__((target("ssse3"))) inline void ssse3(void *data, size_t n) {
+  auto p = static_cast<std::byte *>(data);
+  size_t bytes = n * Size;
+  const __m128i mask = shuffle_mask<Size>();
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i),
+                     _mm_shuffle_epi8(v, mask));
+  }
+  scalar<Size>(p + i, (bytes - i) / Size);
+}
+
+template <size_t Size>
+__attribute__((target("avx2"))) inline void avx2(void *data, size_t n) {
+  auto p = static_cast<std::byte *>(data);
+  size_t bytes = n * Size;
+  const __m256i mask = _mm256_broadcastsi128_si256(shuffle_mask<Size>());
+  size_t i = 0;
+  for (; i + 32 <= bytes; i += 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + i),
+                        _mm256_shuffle_epi8(v, mask));
+  }
+  ssse3<Size>(p + i, (bytes - i) / Size);
+}
+
+#endif
+
+/*
+ * Returns the fastest kernel the CPU supports.
+ * */
+template <size_t Size> inline Kernel select() {
+#ifdef ETCETERA_BYTESWAP_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return avx2<Size>;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return ssse3<Size>;
+  }
+#endif
+  return scalar<Size>;
+}
+
+} // namespace byteswap
+
+/*
+ * Reverses the bytes of n values of Size bytes in place with the kernel
+ * selected for this CPU.
+ * */
+template <size_t Size> inline void byteswap_array(void *data, size_t n) {
+  if constexpr (Size > 1) {
+    static const byteswap::Kernel kernel = byteswap::select<Size>();
+    kernel(data, n);
+  }
+}
+
+} // namespace etcetera
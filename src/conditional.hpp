@@ -18,6 +18,8 @@ protected:
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
 
   IfThenElse(PrivateBase, FIfFn if_fn, std::optional<Field> if_child,
              std::optional<Field> else_child)
@@ -26,25 +28,47 @@ public:
 
   static std::shared_ptr<IfThenElse> create(FIfFn if_fn, Field if_child,
                                             Field else_child) {
-    auto ret = std::make_shared<IfThenElse>(PrivateBase(), if_fn, if_child,
-                                            else_child);
-    if_child.second->set_parent(ret);
+    auto ret =
+        make_node<IfThenElse>(PrivateBase(), if_fn, if_child, else_child);
+    if_child.second->set_parent(ret.get());
     if_child.second->set_name(if_child.first);
-    else_child.second->set_parent(ret);
+    else_child.second->set_parent(ret.get());
     else_child.second->set_name(else_child.first);
     return ret;
   }
   static std::shared_ptr<IfThenElse> create(FIfFn if_fn, Field if_child) {
-    auto ret = std::make_shared<IfThenElse>(PrivateBase(), if_fn, if_child,
-                                            std::nullopt);
-    if_child.second->set_parent(ret);
+    auto ret =
+        make_node<IfThenElse>(PrivateBase(), if_fn, if_child, std::nullopt);
+    if_child.second->set_parent(ret.get());
     if_child.second->set_name(if_child.first);
     return ret;
   }
 
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<IfThenElse>(*this);
+    for (auto *child : {&ret->if_child, &ret->else_child}) {
+      if (*child) {
+        child->value().second = child->value().second->clone();
+        child->value().second->set_parent(ret.get());
+      }
+    }
+    return ret;
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(if_fn);
+  }
+
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    auto &child = call(if_fn) ? if_child : else_child;
+    if (child) {
+      fn(*child.value().second);
+    }
+  }
+
   size_t get_size() override {
     std::shared_ptr<Base> child;
-    if (if_fn(this->parent)) {
+    if (call(if_fn)) {
       if (!if_child) {
         return 0;
       }
@@ -58,9 +82,19 @@ public:
     return child->get_size();
   }
 
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    if (if_child) {
+      if_child.value().second->invalidate_offset();
+    }
+    if (else_child) {
+      else_child.value().second->invalidate_offset();
+    }
+  }
+
   std::any get() override {
     std::shared_ptr<Base> child;
-    if (if_fn(this->parent)) {
+    if (call(if_fn)) {
       if (!if_child) {
         return std::any();
       }
@@ -89,7 +123,7 @@ public:
 
   std::weak_ptr<Base> get_field(std::string key) override {
     std::shared_ptr<Base> child;
-    if (if_fn(this->parent)) {
+    if (call(if_fn)) {
       if (!if_child) {
         return std::weak_ptr<Base>();
       }
@@ -103,9 +137,11 @@ public:
     return child->get_field(key);
   }
 
-  std::any parse(std::istream &stream) override {
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("IfThenElse::parse", name, idx, cursor);
     std::shared_ptr<Base> child;
-    if (if_fn(this->parent)) {
+    if (call(if_fn)) {
       if (!if_child) {
         return std::any();
       }
@@ -116,28 +152,25 @@ public:
       }
       child = else_child.value().second;
     }
-    return child->parse(stream);
+    return child->parse(cursor);
   }
 
-  void build(std::iostream &stream) override {
-    if (if_fn(this->parent)) {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    if (call(if_fn)) {
       if (if_child) {
-        spdlog::debug("IfThenElse::build {}", if_child.value().first);
         try {
-          if_child.value().second->build(stream);
-        } catch (std::exception &e) {
-          throw std::runtime_error(if_child.value().first + "->" +
-                                   std::string(e.what()));
+          if_child.value().second->build(cursor);
+        } catch (...) {
+          rethrow_at<BuildFailure>(if_child.value().first, cursor.tell());
         }
       }
     } else {
       if (else_child) {
         try {
-          spdlog::debug("IfThenElse::build {}", else_child.value().first);
-          else_child.value().second->build(stream);
-        } catch (std::exception &e) {
-          throw std::runtime_error(else_child.value().first + "->" +
-                                   std::string(e.what()));
+          else_child.value().second->build(cursor);
+        } catch (...) {
+          rethrow_at<BuildFailure>(else_child.value().first, cursor.tell());
         }
       }
     }
@@ -180,7 +213,7 @@ public:
   }
 
   pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
-    if (if_fn(this->parent)) {
+    if (call(if_fn)) {
       if (!if_child) {
         return parent;
       }
@@ -210,6 +243,8 @@ public:
   typedef std::tuple<T, std::string, FTypeFn> SwitchField;
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
   using Base::get_offset;
 
   template <typename... Args>
@@ -225,12 +260,41 @@ public:
 
   template <typename... Args>
   static std::shared_ptr<Switch> create(FSwitchFn switch_fn, Args &&...args) {
-    return std::make_shared<Switch>(PrivateBase(), switch_fn, args...);
+    return make_node<Switch>(PrivateBase(), switch_fn, args...);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<Switch>(*this);
+    ret->current = {};
+    return ret;
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(switch_fn);
+  }
+
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    if (current) {
+      fn(*current);
+    }
   }
 
   size_t get_size() override { return current->get_size(); }
+  bool size_memoized() override {
+    return current && current->size_memoized();
+  }
+
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    if (current) {
+      current->invalidate_offset();
+    }
+  }
 
   std::any get() override { return current->get(); }
+  ValueView value_view() override { return current->value_view(); }
+  std::any get(std::string key) override { return current->get(key); }
+  bool has_field_nodes() override { return current->has_field_nodes(); }
 
   std::vector<std::string> get_names() override {
     std::vector<std::string> ret;
@@ -244,26 +308,27 @@ public:
     return current->get_field(key);
   }
 
-  std::any parse(std::istream &stream) override {
-    value = switch_fn(this->parent);
-    spdlog::debug("stream pos {:02X} reading {:02X} {}",
-                  (int64_t)stream.tellg(), value, names[value]);
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Switch::parse", name, idx, cursor);
+    value = call(switch_fn);
     if (!fields.contains(value)) {
-      throw std::runtime_error("Switch: " + std::to_string(value) +
-                               " not found!");
+      throw ParseFailure(cursor.tell(), "Switch: " + std::to_string(value) +
+                                            " not found");
     }
     current = fields[value]();
-    current->set_parent(weak_from_this());
+    current->set_parent(this);
     current->set_name(names[value]);
-    return current->parse(stream);
+    return current->parse(cursor);
   }
 
-  void build(std::iostream &stream) override {
-    spdlog::debug("Switch::build {}", (size_t)stream.tellp());
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Switch::build", name, idx, cursor);
     if (!current) {
       throw cpptrace::runtime_error("Switch: no current child");
     }
-    current->build(stream);
+    current->build(cursor);
   }
 
   void parse_xml(pugi::xml_node const &node, std::string,
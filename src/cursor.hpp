@@ -0,0 +1,370 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.hpp"
+#include "helpers.hpp"
+
+namespace etcetera {
+
+/*
+ * An InputSource owns the bytes an InputCursor reads from.
+ *
+ * Sources may use the access hints to prepare regions that are read next,
+ * e.g. by asking the kernel to page them in.
+ * */
+class InputSource {
+public:
+  virtual ~InputSource() = default;
+
+  virtual std::span<const std::byte> bytes() const = 0;
+
+  /*
+   * Hints that [offset, offset + size) will be read soon. A size of 0 means
+   * the size is not known yet and the source picks a sensible window.
+   * */
+  virtual void will_need(size_t, size_t, bool /* sequential */) {}
+};
+
+/*
+ * An InputSource owning a buffer in memory.
+ * */
+class BufferSource : public InputSource {
+  std::vector<std::byte> data;
+
+public:
+  explicit BufferSource(std::vector<std::byte> data) : data(std::move(data)) {}
+
+  std::span<const std::byte> bytes() const override { return data; }
+};
+
+/*
+ * InputCursor is a read position over a contiguous, read-only byte buffer.
+ *
+ * Every node parses from an InputCursor. The position is a plain integer and
+ * each read is bounds checked once, the buffer itself is never copied. The
+ * caller has to keep the buffer alive while parsing, unless the cursor was
+ * created from an InputSource, which it keeps alive itself.
+ * */
+class InputCursor {
+protected:
+  std::span<const std::byte> data;
+  size_t pos = 0;
+  std::shared_ptr<InputSource> source;
+
+  void check(size_t n) const {
+    if (n > remaining()) {
+      throw ParseFailure(pos, "InputCursor: read past the end");
+    }
+  }
+
+public:
+  InputCursor(std::span<const std::byte> data, size_t pos = 0)
+      : data(data), pos(pos) {}
+  InputCursor(std::span<const char> data, size_t pos = 0)
+      : data(std::as_bytes(data)), pos(pos) {}
+  InputCursor(std::shared_ptr<InputSource> source, size_t pos = 0)
+      : data(source->bytes()), pos(pos), source(source) {}
+
+  size_t tell() const { return pos; }
+  size_t size() const { return data.size(); }
+  size_t remaining() const { return pos < data.size() ? data.size() - pos : 0; }
+  bool eof() const { return pos >= data.size(); }
+
+  /*
+   * Returns the whole underlying buffer, independent of the position.
+   * */
+  std::span<const std::byte> buffer() const { return data; }
+
+  /*
+   * Forwards an access hint to the source, if there is one.
+   * */
+  void will_need(size_t offset, size_t size, bool sequential = false) {
+    if (source && offset < data.size()) {
+      source->will_need(offset, std::min(size, data.size() - offset),
+                        sequential);
+    }
+  }
+
+  void seek(size_t offset) {
+    if (offset > data.size()) {
+      throw ParseFailure(offset, "InputCursor: seek past the end");
+    }
+    pos = offset;
+  }
+
+  void skip(size_t n) {
+    check(n);
+    pos += n;
+  }
+
+  /*
+   * Returns a view of the next n bytes and advances the position.
+   * */
+  std::span<const std::byte> read(size_t n) {
+    check(n);
+    auto ret = data.subspan(pos, n);
+    pos += n;
+    return ret;
+  }
+
+  void read(void *dst, size_t n) {
+    auto src = read(n);
+    // dst and src may be null for empty reads, which memcpy doesn't allow
+    if (n == 0) {
+      return;
+    }
+    std::memcpy(dst, src.data(), n);
+  }
+
+  /*
+   * Reads a trivially copyable value stored with the given byte order.
+   * */
+  template <typename T, std::endian Endianess = std::endian::native> T read() {
+    T value;
+    read(&value, sizeof(T));
+    return swap_endian<Endianess>(value);
+  }
+
+  /*
+   * Reads n trivially copyable values stored with the given byte order with
+   * a single bounds check.
+   * */
+  template <typename T, std::endian Endianess = std::endian::native>
+  void read_array(T *dst, size_t n) {
+    read(dst, n * sizeof(T));
+    swap_endian_n<Endianess>(dst, n);
+  }
+};
+
+/*
+ * An OutputSink receives the bytes an OutputCursor writes, when they should
+ * not be kept in memory as a whole.
+ * */
+class OutputSink {
+public:
+  virtual ~OutputSink() = default;
+
+  /*
+   * Writes bytes at the given absolute offset. Ranges may be written more
+   * than once, the last write wins.
+   * */
+  virtual void write(size_t offset, std::span<const char> bytes) = 0;
+
+  /*
+   * Called by OutputCursor::flush, size is the total size of the output.
+   * */
+  virtual void finish(size_t /* size */) {}
+};
+
+/*
+ * OutputCursor is a write position over a growable, contiguous byte buffer.
+ *
+ * Every node builds into an OutputCursor. Seeking past the end is allowed,
+ * the buffer grows on the next write and holes are zero filled, so Pointers
+ * and Areas can place their data anywhere without pre-sizing the output.
+ *
+ * With an OutputSink the buffer is a bounded window over the output instead.
+ * Sequential writes are collected in the window and handed to the sink in
+ * large batches, writes outside of it flush the window and move it. The
+ * caller has to call flush once building is done.
+ * */
+class OutputCursor {
+protected:
+  std::vector<char> data;
+  // absolute offset of data[0], always 0 without a sink
+  size_t base = 0;
+  // bytes of data in use, with a sink there are no holes below it
+  size_t fill = 0;
+  size_t end = 0;
+  size_t pos = 0;
+  std::shared_ptr<OutputSink> sink;
+
+  /*
+   * Makes [pos, pos + n) writable at data[pos - base].
+   * */
+  void overflow(size_t n) {
+    if (!sink) {
+      if (pos + n > data.size()) {
+        data.resize(std::max(pos + n, data.size() * 2));
+      }
+      return;
+    }
+    if (pos >= base && pos - base <= fill) {
+      // the write continues the window, keep what was written behind pos
+      size_t off = pos - base;
+      if (off > 0) {
+        sink->write(base, std::span(data).first(off));
+      }
+      std::memmove(data.data(), data.data() + off, fill - off);
+      fill -= off;
+      base = pos;
+    } else {
+      flush_window();
+      base = pos;
+    }
+    if (n > data.size()) {
+      data.resize(n);
+    }
+  }
+
+  void flush_window() {
+    if (fill > 0) {
+      sink->write(base, std::span(data).first(fill));
+    }
+    fill = 0;
+  }
+
+public:
+  OutputCursor() = default;
+  OutputCursor(size_t capacity) { data.reserve(capacity); }
+  /*
+   * Writes to the sink through a window of capacity bytes.
+   * */
+  OutputCursor(std::shared_ptr<OutputSink> sink, size_t capacity)
+      : data(capacity), sink(sink) {}
+
+  size_t tell() const { return pos; }
+  size_t size() const { return end; }
+
+  /*
+   * Returns how many bytes one claim can hand out without growing the window
+   * of the sink, SIZE_MAX without a sink.
+   * */
+  size_t window() const { return sink ? data.size() : SIZE_MAX; }
+
+  void reserve(size_t capacity) { data.reserve(capacity); }
+
+  /*
+   * Returns the bytes written so far, independent of the position. Only
+   * available without a sink.
+   * */
+  std::span<const std::byte> buffer() {
+    custom_assert(!sink);
+    data.resize(std::max(data.size(), end));
+    return std::as_bytes(std::span(data).first(end));
+  }
+
+  /*
+   * Moves the written bytes out of the cursor without copying them. The
+   * cursor is empty afterwards. Only available without a sink.
+   * */
+  std::vector<char> release() {
+    custom_assert(!sink);
+    data.resize(end);
+    std::vector<char> ret = std::move(data);
+    data.clear();
+    fill = end = pos = 0;
+    return ret;
+  }
+
+  /*
+   * Hands everything written so far to the sink.
+   * */
+  void flush() {
+    if (sink) {
+      flush_window();
+      sink->finish(end);
+    }
+  }
+
+  void seek(size_t offset) { pos = offset; }
+
+  /*
+   * Advances the position by n bytes, the skipped bytes are part of the
+   * output and zero filled if they were not written yet.
+   * */
+  void skip(size_t n) {
+    pos += n;
+    end = std::max(end, pos);
+  }
+
+  /*
+   * Returns the next n bytes of the output for the caller to fill in and
+   * advances the position. The span is valid until the next write.
+   * */
+  std::span<std::byte> claim(size_t n) {
+    size_t off = pos - base;
+    if (pos < base || off > fill || off + n > data.size()) {
+      overflow(n);
+      off = pos - base;
+    }
+    pos += n;
+    fill = std::max(fill, off + n);
+    end = std::max(end, pos);
+    return std::as_writable_bytes(std::span(data).subspan(off, n));
+  }
+
+  void write(const void *src, size_t n) {
+    // src may be null for empty writes, which memcpy doesn't allow
+    if (n == 0) {
+      return;
+    }
+    auto dst = claim(n);
+    std::memcpy(dst.data(), src, n);
+  }
+
+  /*
+   * Writes a trivially copyable value with the given byte order.
+   * */
+  template <typename T, std::endian Endianess = std::endian::native>
+  void write(T value) {
+    value = swap_endian<Endianess>(value);
+    write(&value, sizeof(T));
+  }
+
+  /*
+   * Writes n trivially copyable values with the given byte order.
+   * */
+  template <typename T, std::endian Endianess = std::endian::native>
+  void write_array(const T *src, size_t n) {
+    if constexpr (Endianess == std::endian::native || sizeof(T) == 1) {
+      write(static_cast<const void *>(src), n * sizeof(T));
+    } else {
+      std::vector<T> tmp(src, src + n);
+      swap_endian_n<Endianess>(tmp.data(), n);
+      write(static_cast<const void *>(tmp.data()), n * sizeof(T));
+    }
+  }
+};
+
+/*
+ * StreamSink writes the output of an OutputCursor into a std::ostream at
+ * absolute offsets. Holes behind the end of the stream are zero filled,
+ * bytes that are not written keep their contents.
+ * */
+class StreamSink : public OutputSink {
+  std::ostream &stream;
+
+  void extend(size_t size) {
+    static constexpr char zeros[4096] = {};
+    stream.seekp(0, std::ios_base::end);
+    for (size_t end = stream.tellp(); end < size;) {
+      size_t n = std::min(size - end, sizeof(zeros));
+      stream.write(zeros, n);
+      end += n;
+    }
+  }
+
+public:
+  explicit StreamSink(std::ostream &stream) : stream(stream) {}
+
+  void write(size_t offset, std::span<const char> bytes) override {
+    extend(offset);
+    stream.seekp(offset);
+    stream.write(bytes.data(), bytes.size());
+  }
+
+  void finish(size_t size) override { extend(size); }
+};
+
+} // namespace etcetera
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace etcetera {
+
+// a struct key or an array index
+typedef std::variant<std::string, size_t> PathElement;
+
+/*
+ * Describes why and where parsing failed. The path leads from the parsed
+ * object to the failing one, the offset is the absolute position of the
+ * failure. The readable message is only built by message().
+ * */
+struct ParseError {
+  // innermost element first, as it is collected while unwinding
+  std::vector<PathElement> path;
+  size_t offset = 0;
+  std::string reason;
+
+  /*
+   * Returns the path like "[header]->[entries]->3->[name]", keys in
+   * brackets and indices as they are.
+   * */
+  std::string path_string() const {
+    std::string ret;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      if (!ret.empty()) {
+        ret += "->";
+      }
+      if (auto key = std::get_if<std::string>(&*it)) {
+        ret += "[" + *key + "]";
+      } else {
+        ret += std::to_string(std::get<size_t>(*it));
+      }
+    }
+    return ret;
+  }
+
+  std::string message() const {
+    return path_string() + " @" + std::to_string(offset) + ": " + reason;
+  }
+};
+
+/*
+ * An error with a ParseError describing where it happened. Unlike cpptrace
+ * errors it does not capture a stack trace and containers only add their key
+ * to the path on the way up, so failing is cheap.
+ * */
+class PathFailure : public std::runtime_error {
+  mutable std::string what_;
+
+public:
+  ParseError error;
+
+  PathFailure(size_t offset, std::string reason)
+      : std::runtime_error(reason), error{{}, offset, std::move(reason)} {}
+
+  const char *what() const noexcept override {
+    try {
+      what_ = error.message();
+      return what_.c_str();
+    } catch (...) {
+      return error.reason.c_str();
+    }
+  }
+};
+
+/*
+ * Thrown by parse. Base::try_parse returns the ParseError instead.
+ * */
+class ParseFailure : public PathFailure {
+public:
+  using PathFailure::PathFailure;
+};
+
+/*
+ * Thrown by build, the offset is the position in the output.
+ * */
+class BuildFailure : public PathFailure {
+public:
+  using PathFailure::PathFailure;
+};
+
+/*
+ * Rethrows the active exception from within a catch block of a container, with
+ * the element it was parsing added to the path. Other exceptions are turned
+ * into a TFailure at offset, build passes BuildFailure.
+ * */
+template <typename TFailure = ParseFailure>
+[[noreturn]] void rethrow_at(PathElement element, size_t offset) {
+  try {
+    throw;
+  } catch (PathFailure &e) {
+    e.error.path.push_back(std::move(element));
+    throw;
+  } catch (std::exception &e) {
+    TFailure failure(offset, e.what());
+    failure.error.path.push_back(std::move(element));
+    throw failure;
+  }
+}
+
+} // namespace etcetera
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cursor.hpp"
+
+namespace etcetera {
+
+/*
+ * FileSink writes the output of an OutputCursor directly to a file.
+ *
+ * All writes are positional, so Pointer and Area data can be placed anywhere
+ * without seeking a shared stream. Memory use is bounded by the window of the
+ * cursor, batching small writes is done there.
+ * */
+class FileSink : public OutputSink,
+                 public std::enable_shared_from_this<FileSink> {
+protected:
+  int fd = -1;
+  std::string path;
+  size_t written = 0;
+
+  struct PrivateFileSink {};
+
+  void fail(int err) {
+    throw cpptrace::runtime_error("FileSink: " + path + ": " +
+                                  std::strerror(err));
+  }
+
+public:
+  FileSink(PrivateFileSink, const std::string &path) : path(path) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      fail(errno);
+    }
+  }
+
+  FileSink(const FileSink &) = delete;
+  FileSink &operator=(const FileSink &) = delete;
+
+  ~FileSink() override {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  static std::shared_ptr<FileSink> open(const std::string &path) {
+    return std::make_shared<FileSink>(PrivateFileSink(), path);
+  }
+
+  /*
+   * Returns a cursor writing to this file, which buffers at most capacity
+   * bytes in memory.
+   * */
+  OutputCursor cursor(size_t capacity = 1024 * 1024) {
+    return OutputCursor(shared_from_this(), capacity);
+  }
+
+  void write(size_t offset, std::span<const char> bytes) override {
+    while (!bytes.empty()) {
+      ssize_t ret = pwrite(fd, bytes.data(), bytes.size(), offset);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        fail(errno);
+      }
+      offset += ret;
+      bytes = bytes.subspan(ret);
+    }
+    written = std::max(written, offset);
+  }
+
+  void finish(size_t size) override {
+    // skipped bytes at the end were never written, extend the file with zeros
+    if (written < size && ftruncate(fd, size) != 0) {
+      fail(errno);
+    }
+  }
+};
+
+} // namespace etcetera
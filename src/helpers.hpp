@@ -1,8 +1,12 @@
 #pragma once
 
+#include <bit>
+#include <cstdint>
 #include <memory>
 #include <cpptrace/cpptrace.hpp>
 
+#include "byteswap.hpp"
+
 namespace etcetera {
 
 inline void custom_assert(bool condition) {
@@ -15,6 +19,37 @@ inline int64_t modulo(int64_t a, int64_t b) {
   return a >= 0 ? a % b : (b - abs(a % b)) % b;
 }
 
+template <size_t Size> struct UnsignedOfSize;
+template <> struct UnsignedOfSize<1> { using type = uint8_t; };
+template <> struct UnsignedOfSize<2> { using type = uint16_t; };
+template <> struct UnsignedOfSize<4> { using type = uint32_t; };
+template <> struct UnsignedOfSize<8> { using type = uint64_t; };
+
+/*
+ * Converts a value between native and the given byte order. The conversion is
+ * symmetric, so it is used for reading and writing alike. Works for floats as
+ * well as integers.
+ * */
+template <std::endian Endianess, typename T> inline T swap_endian(T value) {
+  if constexpr (Endianess != std::endian::native && sizeof(T) > 1) {
+    using U = typename UnsignedOfSize<sizeof(T)>::type;
+    return std::bit_cast<T>(std::byteswap(std::bit_cast<U>(value)));
+  } else {
+    return value;
+  }
+}
+
+/*
+ * Converts n values in place between native and the given byte order, using
+ * the vectorized kernels from byteswap.hpp.
+ * */
+template <std::endian Endianess, typename T>
+inline void swap_endian_n(T *values, size_t n) {
+  if constexpr (Endianess != std::endian::native && sizeof(T) > 1) {
+    byteswap_array<sizeof(T)>(values, n);
+  }
+}
+
 template <typename T> inline std::shared_ptr<T> lock(std::weak_ptr<T> ptr) {
   if (auto ret = ptr.lock()) {
     return ret;
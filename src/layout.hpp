@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "basic.hpp"
+#include "pointer.hpp"
+
+namespace etcetera {
+
+/*
+ * Layout places the payloads of Pointers and Areas before building, instead
+ * of Rebuild callbacks computing their offsets from the sizes of siblings.
+ *
+ * The offsets and sizes are stored in the fields the offset and size
+ * expressions read, so they have to be a field plus a constant:
+ *
+ *   using namespace etcetera::expr;
+ *   auto root = Struct::create(
+ *       Field("offset", Int32ul::create()), Field("size", Int32ul::create()),
+ *       Field("data", Area::create(this_["offset"], this_["size"], ...)));
+ *
+ *   Layout layout;
+ *   layout.alignment = 16;
+ *   OutputCursor cursor;
+ *   layout.build(*root, cursor);
+ *
+ * apply visits the tree once. The payloads are appended behind the tree in
+ * the order they are found, each starting at a multiple of alignment, unless
+ * place picks another offset. Payloads with a constant offset stay where
+ * they are. build writes the tree and then the payloads in the order of
+ * their offsets, so a sink sees strictly sequential writes.
+ * */
+class Layout {
+protected:
+  struct Payload {
+    size_t offset;
+    Pointer *pointer;
+    Area *area;
+  };
+  std::vector<Payload> payloads;
+
+  /*
+   * Collects the Pointers and Areas below node, without the ones inside
+   * their payloads.
+   * */
+  static void collect(Base &node, std::vector<Payload> &ret) {
+    node.for_each_child([&](Base &child) {
+      if (auto pointer = dynamic_cast<Pointer *>(&child)) {
+        ret.push_back({0, pointer, nullptr});
+      } else if (auto area = dynamic_cast<Area *>(&child)) {
+        ret.push_back({0, nullptr, area});
+      } else {
+        collect(child, ret);
+      }
+    });
+  }
+
+public:
+  // every payload starts at a multiple of this
+  size_t alignment = 1;
+  // picks the offset of a payload of size bytes, end is the end of the
+  // output so far and already aligned
+  std::function<size_t(Base &payload, size_t size, size_t end)> place;
+
+  /*
+   * Places all payloads below root, which starts at start, and returns the
+   * end of the output.
+   * */
+  size_t apply(Base &root, size_t start = 0) {
+    payloads.clear();
+    size_t end = start + root.get_size();
+    collect(root, payloads);
+    // payloads are appended while they are placed, nested ones come last
+    for (size_t i = 0; i < payloads.size(); i++) {
+      auto &payload = payloads[i];
+      Base &node = payload.pointer ? static_cast<Base &>(*payload.pointer)
+                                   : static_cast<Base &>(*payload.area);
+      size_t size = node.get_ptr_size(std::weak_ptr<Base>());
+      size_t offset = end + modulo(-end, std::max<size_t>(alignment, 1));
+      if (place) {
+        offset = place(node, size, offset);
+      }
+      payload.offset = payload.pointer ? payload.pointer->place(offset)
+                                       : payload.area->place(offset);
+      end = std::max(end, payload.offset + size);
+      // invalidates payload
+      collect(node, payloads);
+    }
+    return end;
+  }
+
+  /*
+   * Places all payloads below root and builds it at the cursor, followed by
+   * the payloads. The cursor ends up behind the last payload.
+   * */
+  void build(Base &root, OutputCursor &cursor) {
+    apply(root, cursor.tell());
+    for (auto &payload : payloads) {
+      if (payload.pointer) {
+        payload.pointer->payload_inline = false;
+      } else {
+        payload.area->payload_inline = false;
+      }
+    }
+    auto restore = [&]() {
+      for (auto &payload : payloads) {
+        if (payload.pointer) {
+          payload.pointer->payload_inline = true;
+        } else {
+          payload.area->payload_inline = true;
+        }
+      }
+    };
+    try {
+      root.build(cursor);
+      auto sorted = payloads;
+      std::stable_sort(sorted.begin(), sorted.end(),
+                       [](auto &a, auto &b) { return a.offset < b.offset; });
+      for (auto &payload : sorted) {
+        cursor.seek(payload.offset);
+        if (payload.pointer) {
+          payload.pointer->build_payload(cursor);
+        } else {
+          payload.area->build_payload(cursor);
+        }
+      }
+    } catch (...) {
+      restore();
+      throw;
+    }
+    restore();
+  }
+};
+
+} // namespace etcetera
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cursor.hpp"
+
+namespace etcetera {
+
+/*
+ * MappedFile maps a file read-only into memory and feeds InputCursors from it
+ * without copying.
+ *
+ * Access hints are turned into madvise calls, so the kernel starts reading
+ * Pointer and Area targets before they are touched. Hints without a size use
+ * the readahead window.
+ * */
+class MappedFile : public InputSource,
+                   public std::enable_shared_from_this<MappedFile> {
+protected:
+  int fd = -1;
+  std::byte *addr = nullptr;
+  size_t length = 0;
+  size_t page_size = sysconf(_SC_PAGESIZE);
+
+  struct PrivateMappedFile {};
+
+public:
+  size_t readahead = 64 * 1024;
+
+  MappedFile(PrivateMappedFile, const std::string &path) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw cpptrace::runtime_error("MappedFile: " + path + ": " +
+                                    std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      int err = errno;
+      ::close(fd);
+      throw cpptrace::runtime_error("MappedFile: " + path + ": " +
+                                    std::strerror(err));
+    }
+    length = st.st_size;
+    if (length == 0) {
+      return;
+    }
+    void *ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+      int err = errno;
+      ::close(fd);
+      throw cpptrace::runtime_error("MappedFile: " + path + ": " +
+                                    std::strerror(err));
+    }
+    addr = static_cast<std::byte *>(ptr);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() override {
+    if (addr) {
+      munmap(addr, length);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  static std::shared_ptr<MappedFile> open(const std::string &path) {
+    return std::make_shared<MappedFile>(PrivateMappedFile(), path);
+  }
+
+  std::span<const std::byte> bytes() const override { return {addr, length}; }
+
+  size_t size() const { return length; }
+
+  InputCursor cursor(size_t pos = 0) {
+    return InputCursor(shared_from_this(), pos);
+  }
+
+  void will_need(size_t offset, size_t size, bool sequential) override {
+    if (!addr || offset >= length) {
+      return;
+    }
+    if (size == 0) {
+      size = readahead;
+    }
+    size_t begin = offset - offset % page_size;
+    size_t end = std::min(offset + size, length);
+    // these are only hints, failing them does not affect parsing
+    if (sequential) {
+      madvise(addr + begin, end - begin, MADV_SEQUENTIAL);
+    }
+    madvise(addr + begin, end - begin, MADV_WILLNEED);
+  }
+};
+
+} // namespace etcetera
@@ -9,52 +9,54 @@ class NumberType : public Base {
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
+  typedef TNumberType value_type;
+  static constexpr std::endian endianess = Endianess;
+
   TNumberType value = 0;
   NumberType(PrivateBase) : Base(PrivateBase()) {}
   static std::shared_ptr<NumberType> create() {
-    return std::make_shared<NumberType>(PrivateBase());
+    return make_node<NumberType>(PrivateBase());
   }
-  std::any parse(std::istream &stream) override {
-    stream.read(reinterpret_cast<char *>(&value), sizeof(value));
-    if constexpr (Endianess != std::endian::native) {
-      union {
-        TNumberType value;
-        char bytes[sizeof(TNumberType)];
-      } bswap;
-      bswap.value = value;
-      for (size_t i = 0; i < sizeof(TNumberType) / 2; i++) {
-        std::swap(bswap.bytes[i], bswap.bytes[sizeof(TNumberType) - i - 1]);
-      }
-      value = bswap.value;
-    }
-    spdlog::debug("NumberType::parse {:02X} {} {}", (size_t)stream.tellg(),
-                  name, value);
-    return value;
+
+  std::shared_ptr<Base> clone() const override {
+    return make_node<NumberType>(*this);
   }
-  void build(std::iostream &stream) override {
-    auto val = value;
-    if constexpr (Endianess != std::endian::native) {
-      union {
-        TNumberType value;
-        char bytes[sizeof(TNumberType)];
-      } bswap;
-      bswap.value = value;
-      for (size_t i = 0; i < sizeof(TNumberType) / 2; i++) {
-        std::swap(bswap.bytes[i], bswap.bytes[sizeof(TNumberType) - i - 1]);
-      }
-      val = bswap.value;
-    }
-    spdlog::debug("NumberType::build {:02X} {} {}", (size_t)stream.tellp(),
-                  name, val);
-    stream.write(reinterpret_cast<char *>(&val), sizeof(val));
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("NumberType::parse", name, idx, cursor);
+    value = cursor.read<TNumberType, Endianess>();
+    return result(value);
+  }
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("NumberType::build", name, idx, cursor);
+    cursor.write<TNumberType, Endianess>(value);
   }
   std::any get() override { return value; }
+  ValueView value_view() override { return &value; }
   void set(std::any value) override {
     this->value = std::any_cast<TNumberType>(value);
   }
   bool is_simple_type() override { return true; }
 
   size_t get_size() override { return sizeof(TNumberType); }
+  bool size_memoized() override { return true; }
+  std::optional<size_t> fixed_size() override { return sizeof(TNumberType); }
+
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    std::memcpy(&value, data, sizeof(TNumberType));
+    value = swap_endian<Endianess>(value);
+    return result(value);
+  }
+
+  void build_fixed(std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    TNumberType v = swap_endian<Endianess>(value);
+    std::memcpy(data, &v, sizeof(TNumberType));
+  }
 
   void parse_xml(pugi::xml_node const &node, std::string name, bool) override {
     auto s = node.attribute(name.c_str());
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "basic.hpp"
+
+namespace etcetera {
+
+/*
+ * ThreadPool runs parallel loops on a fixed set of worker threads.
+ *
+ * parallel_for cuts the range into chunks, which the workers and the calling
+ * thread claim one after another, so a slow chunk does not hold up the
+ * others. The caller takes part in the loop, so it finishes even if all
+ * workers are busy.
+ * */
+class ThreadPool {
+protected:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> jobs;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stop = false;
+
+  struct Loop {
+    std::function<void(size_t, size_t)> fn;
+    size_t n;
+    size_t grain;
+    size_t chunks;
+    std::atomic<size_t> next{0};
+    size_t done = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    /*
+     * Claims and runs chunks until there are none left.
+     * */
+    void run() {
+      for (size_t c; (c = next.fetch_add(1)) < chunks;) {
+        try {
+          fn(c * grain, std::min(n, (c + 1) * grain));
+        } catch (...) {
+          std::lock_guard lock(mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+        std::lock_guard lock(mutex);
+        if (++done == chunks) {
+          cv.notify_all();
+        }
+      }
+    }
+  };
+
+  void work() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [this]() { return stop || !jobs.empty(); });
+        if (jobs.empty()) {
+          return;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+public:
+  // loops with fewer elements are not worth spreading over threads
+  size_t min_elements = 4096;
+
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; i++) {
+      workers.emplace_back([this]() { work(); });
+    }
+  }
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard lock(mutex);
+      stop = true;
+    }
+    cv.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  size_t size() const { return workers.size(); }
+
+  /*
+   * Calls fn(begin, end) for slices of [0, n) and returns once all are done.
+   * The first exception thrown by fn is rethrown.
+   * */
+  void parallel_for(size_t n, std::function<void(size_t, size_t)> fn) {
+    if (n == 0) {
+      return;
+    }
+    auto loop = std::make_shared<Loop>();
+    loop->fn = std::move(fn);
+    loop->n = n;
+    // a few chunks per thread, so threads that finish early get more work
+    size_t chunks = std::min(n, (workers.size() + 1) * 4);
+    loop->grain = (n + chunks - 1) / chunks;
+    loop->chunks = (n + loop->grain - 1) / loop->grain;
+    size_t helpers = std::min(workers.size(), loop->chunks - 1);
+    {
+      std::lock_guard lock(mutex);
+      for (size_t i = 0; i < helpers; i++) {
+        jobs.emplace_back([loop]() { loop->run(); });
+      }
+    }
+    cv.notify_all();
+    loop->run();
+    std::unique_lock lock(loop->mutex);
+    loop->cv.wait(lock, [&]() { return loop->done == loop->chunks; });
+    if (loop->error) {
+      std::rethrow_exception(loop->error);
+    }
+  }
+};
+
+// pool used by parse and build on this thread, nullptr to run serially
+inline thread_local ThreadPool *current_pool = nullptr;
+
+/*
+ * Lets Arrays and Areas of fixed size elements parse and build their
+ * elements on the pool, until the scope ends. Other subtrees, like Pointer
+ * targets or elements of variable size, are still parsed and built on the
+ * calling thread:
+ *
+ *   ThreadPool pool;
+ *   ParallelScope scope(pool);
+ *   root->parse(cursor);
+ *
+ * Elements are still created on the calling thread, so type constructors
+ * and arenas need no locking. Callbacks inside an element must not touch
+ * other elements of the same Array.
+ * */
+class ParallelScope {
+  ThreadPool *previous;
+
+public:
+  ParallelScope(ThreadPool &pool) : previous(current_pool) {
+    current_pool = &pool;
+  }
+  ~ParallelScope() { current_pool = previous; }
+  ParallelScope(const ParallelScope &) = delete;
+  ParallelScope &operator=(const ParallelScope &) = delete;
+};
+
+/*
+ * Parses elements[i] from the stride bytes at data + i * stride on the pool.
+ * offset is the absolute offset of data. If elements fail, the first one is
+ * reported like a serial parse would.
+ * */
+inline void parse_fixed_elements(ThreadPool &pool,
+                                 std::span<const std::shared_ptr<Base>> elements,
+                                 const std::byte *data, size_t offset,
+                                 size_t stride) {
+  bool collect = collect_results;
+  std::mutex mutex;
+  size_t failed = SIZE_MAX;
+  std::exception_ptr error;
+  pool.parallel_for(elements.size(), [&](size_t begin, size_t end) {
+    bool previous = collect_results;
+    collect_results = collect;
+    for (size_t i = begin; i < end; i++) {
+      try {
+        elements[i]->parse_fixed(data + i * stride, offset + i * stride);
+      } catch (...) {
+        std::lock_guard lock(mutex);
+        if (i < failed) {
+          failed = i;
+          error = std::current_exception();
+        }
+        break;
+      }
+    }
+    collect_results = previous;
+  });
+  if (error) {
+    try {
+      std::rethrow_exception(error);
+    } catch (...) {
+      rethrow_at(failed, offset + failed * stride);
+    }
+  }
+}
+
+/*
+ * Returns the fixed size all elements share, or nullopt if one of them has
+ * none or a different one. Elements made by the same type constructor can
+ * still differ, e.g. a NumberArray resized by set.
+ * */
+inline std::optional<size_t>
+common_stride(std::span<const std::shared_ptr<Base>> elements) {
+  if (elements.empty()) {
+    return std::nullopt;
+  }
+  auto stride = elements[0]->fixed_size();
+  for (size_t i = 1; stride && i < elements.size(); i++) {
+    if (elements[i]->fixed_size() != stride) {
+      return std::nullopt;
+    }
+  }
+  return stride;
+}
+
+/*
+ * Builds elements[i] into the stride bytes at data + i * stride on the pool,
+ * offset is the absolute offset of data. Errors name the first failing
+ * element, like Array::build does, counting from first.
+ * */
+inline void build_fixed_elements(ThreadPool &pool,
+                                 std::span<const std::shared_ptr<Base>> elements,
+                                 std::byte *data, size_t offset, size_t stride,
+                                 size_t first = 0) {
+  std::mutex mutex;
+  size_t failed = SIZE_MAX;
+  std::exception_ptr error;
+  pool.parallel_for(elements.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      try {
+        elements[i]->build_fixed(data + i * stride, offset + i * stride);
+      } catch (...) {
+        std::lock_guard lock(mutex);
+        if (i < failed) {
+          failed = i;
+          error = std::current_exception();
+        }
+        break;
+      }
+    }
+  });
+  if (error) {
+    try {
+      std::rethrow_exception(error);
+    } catch (...) {
+      rethrow_at<BuildFailure>(first + failed, offset + failed * stride);
+    }
+  }
+}
+
+/*
+ * Builds the elements at the cursor on the pool. The output is claimed one
+ * window of the sink at a time, so the window does not grow to the size of
+ * all elements.
+ * */
+inline void build_fixed_elements(ThreadPool &pool,
+                                 std::span<const std::shared_ptr<Base>> elements,
+                                 OutputCursor &cursor, size_t stride) {
+  size_t batch = std::max<size_t>(cursor.window() / std::max<size_t>(stride, 1),
+                                  1);
+  for (size_t begin = 0; begin < elements.size(); begin += batch) {
+    size_t n = std::min(batch, elements.size() - begin);
+    size_t offset = cursor.tell();
+    auto bytes = cursor.claim(n * stride);
+    build_fixed_elements(pool, elements.subspan(begin, n), bytes.data(), offset,
+                         stride, begin);
+  }
+}
+
+} // namespace etcetera
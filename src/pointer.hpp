@@ -1,12 +1,22 @@
 #pragma once
 
 #include "basic.hpp"
+#include "parallel.hpp"
+#include "schedule.hpp"
 
 namespace etcetera {
 
 /*
  * Pointer is a field with size 0 which gets an offset and parses its field
  * from that offset.
+ *
+ * A Pointer made by create_lazy only records the offset when it is parsed.
+ * The field is parsed on first access, from a copy of the cursor, so files
+ * with many pointers to large blobs are opened without reading them. Like
+ * for LazyArray, a plain buffer has to outlive the Pointer then.
+ *
+ * Inside a ReadScheduler, other Pointers defer their field the same way and
+ * the scheduler parses it once the tree is done.
  */
 class Pointer : public Base {
 protected:
@@ -14,64 +24,172 @@ protected:
   FOffsetFn offset_fn;
   size_t offset;
   std::shared_ptr<Base> sub;
+  bool lazy = false;
+  // positioned at the offset, until the field is parsed
+  std::optional<InputCursor> pending;
+
+  /*
+   * Returns the field, parses it first if it is pending.
+   * */
+  Base &loaded() {
+    if (pending) {
+      InputCursor cursor = pending.value();
+      try {
+        sub->parse(cursor);
+      } catch (...) {
+        rethrow_at(name, cursor.tell());
+      }
+      pending.reset();
+    }
+    return *sub;
+  }
 
 public:
+  // false while a Layout builds the payload behind the tree
+  bool payload_inline = true;
+
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
 
   Pointer(PrivateBase, FOffsetFn offset_fn, std::shared_ptr<Base> s)
       : Base(PrivateBase()), offset_fn(offset_fn), sub(s) {}
 
   static std::shared_ptr<Pointer> create(FOffsetFn offset_fn,
                                          std::shared_ptr<Base> s) {
-    auto ret = std::make_shared<Pointer>(PrivateBase(), offset_fn, s);
-    ret->sub->set_parent(ret);
+    auto ret = make_node<Pointer>(PrivateBase(), offset_fn, s);
+    ret->sub->set_parent(ret.get());
+    return ret;
+  }
+  static std::shared_ptr<Pointer> create_lazy(FOffsetFn offset_fn,
+                                              std::shared_ptr<Base> s) {
+    auto ret = create(offset_fn, s);
+    ret->lazy = true;
+    return ret;
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<Pointer>(*this);
+    ret->sub = sub->clone();
+    ret->sub->set_parent(ret.get());
+    ret->pending.reset();
     return ret;
   }
 
+  /*
+   * Returns the field the pointer points to.
+   * */
+  Base &target() { return loaded(); }
+
+  /*
+   * Returns true if the field is parsed, false if a lazy Pointer did not
+   * parse it yet.
+   * */
+  bool is_loaded() const { return !pending; }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(offset_fn);
+  }
+
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    fn(loaded());
+  }
+
   bool is_pointer_type() override { return true; }
 
   size_t get_size() override { return 0; }
+  bool size_memoized() override { return true; }
 
   size_t get_ptr_offset(std::weak_ptr<Base>) override {
-    return offset_fn(this->parent);
+    return call(offset_fn);
+  }
+  size_t get_ptr_size(std::weak_ptr<Base>) override {
+    return loaded().get_size();
+  }
+
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    sub->invalidate_offset();
   }
-  size_t get_ptr_size(std::weak_ptr<Base>) override { return sub->get_size(); }
 
-  std::any get() override { return sub->get(); }
+  std::any get() override { return loaded().get(); }
+  ValueView value_view() override { return loaded().value_view(); }
+  std::any get(size_t key) override { return parent_ref().get(key); }
   std::weak_ptr<Base> get_field(size_t key) override {
-    return lock(this->parent)->get_field(key);
+    return parent_ref().get_field(key);
   }
   std::weak_ptr<Base> get_field(std::string key) override {
-    return lock(this->parent)->get_field(key);
+    return parent_ref().get_field(key);
+  }
+  std::optional<size_t> field_index(std::string_view key) override {
+    return parent_ref().field_index(key);
+  }
+  Base *get_field_at(size_t index) override {
+    return parent_ref().get_field_at(index);
   }
 
-  std::any parse(std::istream &s) override {
-    offset = offset_fn(this->parent);
-    size_t old_offset = s.tellg();
-    s.seekg(offset);
-    auto ret = sub->parse(s);
-    s.seekg(old_offset);
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Pointer::parse", name, idx, cursor);
+    offset = call(offset_fn);
+    if (lazy || current_scheduler) {
+      pending = cursor;
+      pending->seek(offset);
+      if (!lazy) {
+        current_scheduler->defer(offset, sub->fixed_size().value_or(0),
+                                 [this]() { loaded(); });
+      }
+      return {};
+    }
+    // no will_need here, a hint right before the read can't get ahead of
+    // it, ReadScheduler announces targets with lead time instead
+    size_t old_offset = cursor.tell();
+    cursor.seek(offset);
+    auto ret = sub->parse(cursor);
+    cursor.seek(old_offset);
     return ret;
   }
 
-  void build(std::iostream &s) override {
-    offset = offset_fn(this->parent);
-    size_t old_offset = s.tellp();
-    s.seekp(offset);
-    sub->build(s);
-    s.seekp(old_offset);
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    offset = call(offset_fn);
+    if (!payload_inline) {
+      return;
+    }
+    size_t old_offset = cursor.tell();
+    cursor.seek(offset);
+    loaded().build(cursor);
+    cursor.seek(old_offset);
+  }
+
+  /*
+   * Builds the payload at the cursor, which has to be at the offset.
+   * */
+  void build_payload(OutputCursor &cursor) { loaded().build(cursor); }
+
+  /*
+   * Places the payload at offset, by storing it in the field the offset
+   * expression reads. A constant offset is kept. Returns the offset.
+   * */
+  size_t place(size_t offset) {
+    if (auto constant = constant_of(offset_fn)) {
+      return constant.value();
+    }
+    assign(offset_fn, offset);
+    return offset;
   }
 
-  void set(std::any value) override { sub->set(value); }
+  void set(std::any value) override { loaded().set(value); }
 
   void parse_xml(pugi::xml_node const &node, std::string name,
                  bool is_root) override {
+    pending.reset();
     sub->parse_xml(node, name, is_root);
   }
 
   pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
-    return sub->build_xml(parent, name);
+    return loaded().build_xml(parent, name);
   }
 };
 
@@ -85,6 +203,8 @@ public:
  * The size function will only be used when parsing to determine the size and
  * get_ptr_size can be used to determine the size when building (e.g. for a
  * rebuild).
+ *
+ * Inside a ReadScheduler the elements are parsed once the tree is done.
  */
 class Area : public Base {
   typedef std::function<int64_t(std::weak_ptr<Base>)> FOffsetFn;
@@ -96,10 +216,70 @@ class Area : public Base {
   FTypeFn type_fn;
 
   std::vector<std::shared_ptr<Base>> data;
+  // fixed size of the elements, set on first use
+  std::optional<std::optional<size_t>> cached_stride;
+  // positioned at the offset, until a ReadScheduler parses the elements
+  std::optional<InputCursor> pending;
+  int64_t pending_size = 0;
+
+  /*
+   * Parses the elements filling the size bytes at the cursor.
+   * */
+  void parse_elements(InputCursor &cursor, int64_t size) {
+    if (current_pool && parse_parallel(cursor, *current_pool, size)) {
+      return;
+    }
+
+    int64_t end_pos = cursor.tell() + size;
+    size_t i = 0;
+    while ((int64_t)cursor.tell() < end_pos) {
+      auto sub = type_fn();
+      sub->set_parent(this);
+      sub->set_idx(i);
+      try {
+        sub->parse(cursor);
+        i += 1;
+      } catch (...) {
+        rethrow_at(i, cursor.tell());
+      }
+      data.push_back(std::move(sub));
+    }
+
+    if ((int64_t)cursor.tell() != end_pos) {
+      throw ParseFailure(cursor.tell(), "Area: data exceeds the size");
+    }
+  }
+
+  std::optional<size_t> element_stride() {
+    if (!cached_stride) {
+      cached_stride = type_fn()->fixed_size();
+    }
+    return cached_stride.value();
+  }
+
+  /*
+   * Parses the elements first if they are pending.
+   * */
+  void loaded() {
+    if (pending) {
+      InputCursor cursor = pending.value();
+      try {
+        parse_elements(cursor, pending_size);
+      } catch (...) {
+        data.clear();
+        rethrow_at(name, cursor.tell());
+      }
+      pending.reset();
+    }
+  }
 
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
+  // false while a Layout builds the elements behind the tree
+  bool payload_inline = true;
 
   Area(PrivateBase, FOffsetFn offset_fn, FSizeFn size_fn, FTypeFn type_fn)
       : Base(PrivateBase()), offset_fn(offset_fn), size_fn(size_fn),
@@ -107,27 +287,75 @@ public:
 
   static std::shared_ptr<Area> create(FOffsetFn offset_fn, FSizeFn size_fn,
                                       FTypeFn type_fn) {
-    return std::make_shared<Area>(PrivateBase(), offset_fn, size_fn, type_fn);
+    return make_node<Area>(PrivateBase(), offset_fn, size_fn, type_fn);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<Area>(*this);
+    ret->data.clear();
+    ret->pending.reset();
+    return ret;
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    auto ret = fields_of(offset_fn);
+    auto more = fields_of(size_fn);
+    ret.insert(ret.end(), more.begin(), more.end());
+    return ret;
+  }
+
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    loaded();
+    for (auto &sub : data) {
+      fn(*sub);
+    }
   }
 
   bool is_array() override { return true; }
   bool is_pointer_type() override { return true; }
 
   std::any get() override { throw cpptrace::runtime_error("Not implemented"); }
-  std::any get(size_t key) override { return data[key]->get(); }
+  std::any get(size_t key) override {
+    loaded();
+    return data[key]->get();
+  }
+
+  std::weak_ptr<Base> get_field(size_t key) override {
+    loaded();
+    return data[key];
+  }
 
-  std::weak_ptr<Base> get_field(size_t key) override { return data[key]; }
+  size_t length() override {
+    loaded();
+    return data.size();
+  }
 
   size_t get_size() override { return 0; }
+  bool size_memoized() override { return true; }
 
   // if an element of the Area ask for its offset, we need to return the "start"
   // offset, so the ptr offset
-  size_t get_offset(size_t key) override { return offset_fn(this->parent); }
+  size_t get_offset(size_t key) override { return call(offset_fn); }
+
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    for (auto &sub : data) {
+      sub->invalidate_offset();
+    }
+  }
+
+  // the Area itself has no size, so nothing behind it moves
+  void invalidate_offsets_after(size_t key) override {
+    for (size_t i = key + 1; i < data.size(); i++) {
+      data[i]->invalidate_offset();
+    }
+  }
 
   size_t get_ptr_offset(std::weak_ptr<Base>) override {
-    return offset_fn(this->parent);
+    return call(offset_fn);
   }
   size_t get_ptr_size(std::weak_ptr<Base>) override {
+    loaded();
     size_t size = 0;
     for (auto &sub : data) {
       size += sub->get_size();
@@ -135,60 +363,122 @@ public:
     return size;
   }
 
-  std::any parse(std::istream &stream) override {
-    auto offset = offset_fn(this->parent);
-    auto size = size_fn(this->parent);
+  /*
+   * Parses fixed size elements filling the size bytes at the cursor on the
+   * pool. Returns false if there are too few or their size is not fixed.
+   * */
+  bool parse_parallel(InputCursor &cursor, ThreadPool &pool, int64_t size) {
+    auto stride = element_stride();
+    if (!stride || stride.value() == 0 || size < 0 ||
+        size % stride.value() != 0 ||
+        size / stride.value() < pool.min_elements) {
+      return false;
+    }
+    size_t offset = cursor.tell();
+    auto bytes = cursor.read(size);
+    size_t count = size / stride.value();
+    data.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      auto sub = type_fn();
+      sub->set_parent(this);
+      sub->set_idx(i);
+      data.push_back(std::move(sub));
+    }
+    parse_fixed_elements(pool, data, bytes.data(), offset, stride.value());
+    return true;
+  }
 
-    data.clear();
+  /*
+   * Builds fixed size elements on the pool, returns false if their sizes are
+   * not fixed or not all the same.
+   * */
+  bool build_parallel(OutputCursor &cursor, ThreadPool &pool) {
+    auto stride = common_stride(data);
+    if (!stride) {
+      return false;
+    }
+    build_fixed_elements(pool, data, cursor, stride.value());
+    return true;
+  }
 
-    size_t old_offset = stream.tellg();
-    stream.seekg(offset);
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Area::parse", name, idx, cursor);
+    auto offset = call(offset_fn);
+    auto size = call(size_fn);
 
-    int64_t end_pos = offset + size;
-    size_t i = 0;
-    while (stream.tellg() < end_pos && stream.tellg() >= 0) {
-      auto sub = type_fn();
-      sub->set_parent(this->shared_from_this());
-      try {
-        sub->parse(stream);
-        i += 1;
-      } catch (std::exception &e) {
-        throw std::runtime_error(std::to_string(i) + "->" +
-                                 std::string(e.what()));
-      }
-      data.push_back(sub);
+    data.clear();
+    pending.reset();
+
+    if (current_scheduler) {
+      pending = cursor;
+      pending->seek(offset);
+      pending_size = size;
+      current_scheduler->defer(offset, std::max<int64_t>(size, 0),
+                               [this]() { loaded(); });
+      return {};
     }
 
-    spdlog::debug("Area::parse assert {} {}", (size_t)stream.tellg(), end_pos);
-    custom_assert(stream.tellg() == end_pos);
+    // unlike the hint a Pointer would give, this one covers the whole
+    // payload, so the source reads ahead of the elements while the first
+    // ones are parsed, instead of faulting in one window at a time
+    size_t old_offset = cursor.tell();
+    cursor.will_need(offset, size, true);
+    cursor.seek(offset);
+    parse_elements(cursor, size);
+    cursor.seek(old_offset);
 
-    stream.seekg(old_offset);
+    return result(data);
+  }
 
-    return data;
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    if (!payload_inline) {
+      return;
+    }
+    size_t old_offset = cursor.tell();
+    cursor.seek(call(offset_fn));
+    build_payload(cursor);
+    cursor.seek(old_offset);
   }
 
-  void build(std::iostream &stream) override {
-    auto offset = offset_fn(this->parent);
-    size_t old_offset = stream.tellp();
-    stream.seekp(offset);
+  /*
+   * Builds the elements at the cursor, which has to be at the offset.
+   * */
+  void build_payload(OutputCursor &cursor) {
+    loaded();
+    int64_t offset = cursor.tell();
+    if (current_pool && data.size() >= current_pool->min_elements &&
+        build_parallel(cursor, *current_pool)) {
+      return;
+    }
 
     size_t i = 0;
     for (auto &sub : data) {
       try {
-        sub->build(stream);
+        sub->build(cursor);
         i += 1;
-      } catch (std::exception &e) {
-        throw std::runtime_error(std::to_string(i) + "->" +
-                                 std::string(e.what()));
+      } catch (...) {
+        rethrow_at<BuildFailure>(i, cursor.tell());
       }
     }
 
-    int64_t test_pos = offset + get_ptr_size(this->parent);
-    spdlog::debug("Area::build assert {} {} {}", (size_t)stream.tellp(),
-                  test_pos, offset);
-    custom_assert(stream.tellp() == test_pos);
+    int64_t test_pos = offset + get_ptr_size(parent_weak());
+    custom_assert((int64_t)cursor.tell() == test_pos);
+  }
 
-    stream.seekp(old_offset);
+  /*
+   * Places the elements at offset, by storing it and their size in the
+   * fields the offset and size expressions read. A constant offset is kept.
+   * Returns the offset.
+   * */
+  size_t place(size_t offset) {
+    assign(size_fn, get_ptr_size(parent_weak()));
+    if (auto constant = constant_of(offset_fn)) {
+      return constant.value();
+    }
+    assign(offset_fn, offset);
+    return offset;
   }
 
   void parse_xml(pugi::xml_node const &node, std::string name, bool) override {
@@ -196,10 +486,11 @@ public:
     spdlog::debug("Area::parse_xml {}", name);
     size_t i = 0;
     data.clear();
+    pending.reset();
     for (auto &child_node : node.children(name.c_str())) {
       spdlog::debug("Area::parse_xml {} {}", name, i);
       auto obj = type_fn();
-      obj->set_parent(weak_from_this());
+      obj->set_parent(this);
       obj->set_idx(i);
       data.push_back(obj);
       try {
@@ -213,6 +504,7 @@ public:
   }
 
   pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
+    loaded();
     size_t i = 0;
     for (auto &obj : data) {
       try {
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "basic.hpp"
+
+namespace etcetera {
+
+class ReadScheduler;
+
+// scheduler that Pointers and Areas defer their targets to, nullptr to parse
+// them where they are found
+inline thread_local ReadScheduler *current_scheduler = nullptr;
+
+/*
+ * ReadScheduler parses the targets of Pointers and Areas in file order,
+ * instead of seeking back and forth in schema order:
+ *
+ *   ReadScheduler scheduler;
+ *   scheduler.parse(*root, cursor);
+ *
+ * While it parses, Pointers and Areas only record their offset. Once the tree
+ * is done, the targets are sorted by offset, ranges less than max_gap apart
+ * are coalesced and announced to the source as one sequential read, and the
+ * targets are parsed in that order. Pointers found inside targets are
+ * scheduled in the next round, until there are none left.
+ *
+ * Like parse_tree, the values are only kept in the tree. Errors in a target
+ * name the path from its Pointer or Area on. Lazy Pointers stay lazy.
+ * */
+class ReadScheduler {
+protected:
+  struct Read {
+    size_t offset;
+    // 0 if not known before parsing
+    size_t size;
+    std::function<void()> parse;
+  };
+  std::vector<Read> reads;
+
+  /*
+   * Hints the coalesced ranges of the sorted batch to the source.
+   * */
+  void announce(const std::vector<Read> &batch, InputCursor &cursor) {
+    for (size_t i = 0; i < batch.size();) {
+      size_t begin = batch[i].offset;
+      size_t end = begin + batch[i].size;
+      for (i++; i < batch.size() && batch[i].offset <= end + max_gap; i++) {
+        end = std::max(end, batch[i].offset + batch[i].size);
+      }
+      cursor.will_need(begin, end - begin, true);
+      ranges += 1;
+    }
+  }
+
+public:
+  // reads less than this many bytes apart are coalesced into one
+  size_t max_gap = 64 * 1024;
+  // number of coalesced ranges announced so far
+  size_t ranges = 0;
+
+  /*
+   * Schedules parse to run once the target at offset is due. size is the
+   * size of the target, or 0 if it is not known.
+   * */
+  void defer(size_t offset, size_t size, std::function<void()> parse) {
+    reads.push_back({offset, size, std::move(parse)});
+  }
+
+  /*
+   * Parses root at the cursor, then all targets below it in offset order.
+   * */
+  void parse(Base &root, InputCursor &cursor) {
+    ReadScheduler *previous = current_scheduler;
+    bool collect = collect_results;
+    current_scheduler = this;
+    collect_results = false;
+    try {
+      root.parse(cursor);
+      while (!reads.empty()) {
+        auto batch = std::move(reads);
+        reads.clear();
+        std::stable_sort(batch.begin(), batch.end(),
+                         [](auto &a, auto &b) { return a.offset < b.offset; });
+        announce(batch, cursor);
+        for (auto &read : batch) {
+          read.parse();
+        }
+      }
+    } catch (...) {
+      reads.clear();
+      current_scheduler = previous;
+      collect_results = collect;
+      throw;
+    }
+    current_scheduler = previous;
+    collect_results = collect;
+  }
+};
+
+} // namespace etcetera
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "basic.hpp"
+
+namespace etcetera {
+
+/*
+ * Schema is an immutable description of a format, which can be shared
+ * between threads.
+ *
+ * The schema keeps an unparsed prototype tree. Every parse works on its own
+ * instance cloned from the prototype, so one schema can parse many files
+ * concurrently. The prototype must not be modified after creating the
+ * schema.
+ * */
+class Schema {
+protected:
+  std::shared_ptr<const Base> prototype;
+
+public:
+  Schema(std::shared_ptr<Base> prototype) : prototype(prototype) {}
+
+  /*
+   * Returns a new, unparsed instance of the schema.
+   * */
+  std::shared_ptr<Base> instantiate() const { return prototype->clone(); }
+
+  std::shared_ptr<Base> parse(InputCursor &cursor) const {
+    auto ret = instantiate();
+    ret->parse_tree(cursor);
+    return ret;
+  }
+
+  /*
+   * Like parse, but returns the error instead of throwing, e.g. to probe
+   * whether data has this format.
+   * */
+  std::expected<std::shared_ptr<Base>, ParseError>
+  try_parse(InputCursor &cursor) const {
+    auto ret = instantiate();
+    try {
+      ret->parse_tree(cursor);
+    } catch (PathFailure &e) {
+      return std::unexpected(std::move(e.error));
+    } catch (std::exception &e) {
+      return std::unexpected(ParseError{{}, cursor.tell(), e.what()});
+    }
+    return ret;
+  }
+
+  /*
+   * Parses into an instance whose nodes are all allocated in the arena. The
+   * arena has to outlive the instance.
+   * */
+  std::shared_ptr<Base> parse(InputCursor &cursor, Arena &arena) const {
+    ArenaScope scope(arena);
+    return parse(cursor);
+  }
+
+  std::shared_ptr<Base> parse(std::istream &stream) const {
+    auto ret = instantiate();
+    ret->parse(stream);
+    return ret;
+  }
+};
+
+} // namespace etcetera
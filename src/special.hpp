@@ -2,6 +2,8 @@
 
 #include "basic.hpp"
 
+#include <optional>
+
 namespace etcetera {
 
 class Rebuild : public Base {
@@ -13,16 +15,24 @@ protected:
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
 
   Rebuild(PrivateBase, FRebuildFn rebuild_fn, std::shared_ptr<Base> child)
       : Base(PrivateBase()), rebuild_fn(rebuild_fn), child(child) {}
 
   static std::shared_ptr<Rebuild> create(FRebuildFn rebuild_fn,
                                          std::shared_ptr<Base> child) {
-    return std::make_shared<Rebuild>(PrivateBase(), rebuild_fn, child);
+    return make_node<Rebuild>(PrivateBase(), rebuild_fn, child);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<Rebuild>(*this);
+    ret->child = child->clone();
+    return ret;
   }
 
-  void set_parent(std::weak_ptr<Base> parent) override {
+  void set_parent(Base *parent) override {
     Base::set_parent(parent);
     child->set_parent(parent);
   }
@@ -37,33 +47,47 @@ public:
     child->set_idx(idx);
   }
 
-  std::any get() override { return rebuild_fn(this->parent); }
+  std::any get() override { return call(rebuild_fn); }
   std::any get_parsed() override {
     spdlog::debug("Rebuild::get_parsed {}", name);
     return child->get();
   }
   size_t get_offset(std::string key) override {
-    return lock(this->parent)->get_offset(key);
+    return parent_ref().get_offset(key);
   }
   size_t get_offset(size_t key) override {
-    return lock(this->parent)->get_offset(key);
+    return parent_ref().get_offset(key);
   }
 
   bool is_struct() override { return child->is_struct(); }
   bool is_array() override { return child->is_array(); }
   bool is_simple_type() override { return child->is_simple_type(); }
 
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    fn(*child);
+  }
+
   size_t get_size() override { return child->get_size(); }
+  bool size_memoized() override { return child->size_memoized(); }
+  // no fixed_size, even if the child has one: the rebuild callback reads
+  // other fields, so it must not run on the bulk or parallel paths
 
-  std::any parse(std::istream &stream) override {
-    spdlog::debug("Rebuild::parse {:02X} {}", (size_t)stream.tellg(), name);
-    return child->parse(stream);
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    child->invalidate_offset();
   }
 
-  void build(std::iostream &stream) override {
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Rebuild::parse", name, idx, cursor);
+    return child->parse(cursor);
+  }
+
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
     auto data = this->get();
     child->set(data);
-    child->build(stream);
+    child->build(cursor);
   }
 
   void parse_xml(pugi::xml_node const &, std::string,
@@ -86,19 +110,36 @@ protected:
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
 
   LazyBound(PrivateBase, FLazyFn lazy_fn)
       : Base(PrivateBase()), lazy_fn(lazy_fn) {}
 
   static std::shared_ptr<LazyBound> create(FLazyFn lazy_fn) {
-    return std::make_shared<LazyBound>(PrivateBase(), lazy_fn);
+    return make_node<LazyBound>(PrivateBase(), lazy_fn);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<LazyBound>(*this);
+    ret->child = {};
+    return ret;
+  }
+
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    if (child) {
+      fn(*child);
+    }
   }
 
   size_t get_size() override { return child->get_size(); }
+  bool size_memoized() override { return child && child->size_memoized(); }
 
   std::any get() override { return child->get(); }
+  ValueView value_view() override { return child->value_view(); }
   std::any get_parsed() override { return child->get(); }
   std::any get(std::string key) override { return child->get(key); };
+  bool has_field_nodes() override { return child->has_field_nodes(); }
   std::weak_ptr<Base> get_field(std::string key) override {
     return child->get_field(key);
   };
@@ -107,6 +148,13 @@ public:
   size_t get_offset(std::string key) override { return child->get_offset(key); }
   size_t get_offset(size_t key) override { return child->get_offset(key); }
 
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    if (child) {
+      child->invalidate_offset();
+    }
+  }
+
   std::vector<std::string> get_names() override {
     // FIXME: hack
     child = lazy_fn(static_pointer_cast<LazyBound>(weak_from_this().lock()));
@@ -117,15 +165,19 @@ public:
 
   FLazyFn get_lazy_fn() { return lazy_fn; }
 
-  std::any parse(std::istream &stream) override {
-    spdlog::debug("LazyBound::parse {:02X} {}", (size_t)stream.tellg(), name);
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("LazyBound::parse", name, idx, cursor);
     child = lazy_fn(static_pointer_cast<LazyBound>(weak_from_this().lock()));
     child->set_parent(this->parent);
     child->set_name(name);
-    return child->parse(stream);
+    return child->parse(cursor);
   }
 
-  void build(std::iostream &stream) override { child->build(stream); }
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    child->build(cursor);
+  }
 
   void parse_xml(pugi::xml_node const &node, std::string name,
                  bool is_root) override {
@@ -151,72 +203,121 @@ protected:
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
 
   Aligned(PrivateBase, std::optional<FAlignmentFn> alignment_fn,
           size_t alignment, std::shared_ptr<Base> child)
       : Base(PrivateBase()), alignment_fn(alignment_fn), alignment(alignment),
         child(child) {}
 
+  void set_parent(Base *parent) override {
+    Base::set_parent(parent);
+    child->set_parent(parent);
+  }
+
+  void set_name(std::string name) override {
+    Base::set_name(name);
+    child->set_name(name);
+  }
+
+  void set_idx(size_t idx) override {
+    Base::set_idx(idx);
+    child->set_idx(idx);
+  }
+
   static std::shared_ptr<Aligned>
   create(std::optional<FAlignmentFn> alignment_fn,
          std::shared_ptr<Base> child) {
-    return std::make_shared<Aligned>(PrivateBase(), alignment_fn, 0, child);
+    return make_node<Aligned>(PrivateBase(), alignment_fn, 0, child);
   }
 
   static std::shared_ptr<Aligned> create(size_t alignment,
                                          std::shared_ptr<Base> child) {
-    return std::make_shared<Aligned>(PrivateBase(), std::nullopt, alignment,
-                                     child);
+    return make_node<Aligned>(PrivateBase(), std::nullopt, alignment, child);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<Aligned>(*this);
+    ret->child = child->clone();
+    return ret;
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    auto ret = child->dependencies();
+    if (alignment_fn) {
+      auto more = fields_of(alignment_fn.value());
+      ret.insert(ret.end(), more.begin(), more.end());
+    }
+    return ret;
+  }
+
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    fn(*child);
   }
 
   size_t get_size() override {
     if (alignment_fn) {
-      alignment = alignment_fn.value()(this->parent);
+      alignment = call(alignment_fn.value());
     }
     auto csize = child->get_size();
     return csize + modulo(-csize, alignment);
   }
+  bool size_memoized() override {
+    return !alignment_fn && child->size_memoized();
+  }
+
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    child->invalidate_offset();
+  }
 
   std::any get() override { return child->get(); }
+  ValueView value_view() override { return child->value_view(); }
   std::any get_parsed() override { return child->get(); }
   std::any get(std::string key) override { return child->get(key); };
+  bool has_field_nodes() override { return child->has_field_nodes(); }
   std::weak_ptr<Base> get_field(std::string key) override {
     return child->get_field(key);
   };
+  std::optional<size_t> field_index(std::string_view key) override {
+    return child->field_index(key);
+  }
+  Base *get_field_at(size_t index) override {
+    return child->get_field_at(index);
+  }
 
-  std::any parse(std::istream &stream) override {
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Aligned::parse", name, idx, cursor);
     if (alignment_fn) {
-      alignment = alignment_fn.value()(this->parent);
+      alignment = call(alignment_fn.value());
     }
     if (alignment < 2) {
       throw cpptrace::runtime_error("Alignment must be at least 2");
     }
-    size_t before_offset = stream.tellg();
-    auto ret = child->parse(stream);
-    size_t after_offset = stream.tellg();
+    size_t before_offset = cursor.tell();
+    auto ret = child->parse(cursor);
+    size_t after_offset = cursor.tell();
     size_t pad = modulo(-(after_offset - before_offset), alignment);
     if (pad > 0) {
-      spdlog::debug("Aligned::parse padding {:02X} {}", (size_t)stream.tellg(),
-                    pad);
-      stream.seekg(pad, std::ios_base::cur);
+      cursor.skip(pad);
     }
-    spdlog::debug("Aligned::parse before {:02X} after {:02X}", before_offset, after_offset);
-    custom_assert(!stream.fail());
     return ret;
   }
 
-  void build(std::iostream &stream) override {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
     if (alignment_fn) {
-      alignment = alignment_fn.value()(this->parent);
+      alignment = call(alignment_fn.value());
     }
-    size_t before_offset = stream.tellp();
-    child->build(stream);
-    size_t after_offset = stream.tellp();
+    size_t before_offset = cursor.tell();
+    child->build(cursor);
+    size_t after_offset = cursor.tell();
     size_t pad = modulo(-(after_offset - before_offset), alignment);
     if (pad > 0) {
-      stream.seekp(pad, std::ios_base::cur);
+      cursor.skip(pad);
     }
-    custom_assert(!stream.fail());
   }
 
   void parse_xml(pugi::xml_node const &node, std::string name,
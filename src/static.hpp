@@ -0,0 +1,637 @@
+#pragma once
+
+#include "basic.hpp"
+#include "number.hpp"
+#include "string.hpp"
+
+#include <array>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <variant>
+
+namespace etcetera {
+
+/*
+ * Compile-time schemas.
+ *
+ * A StaticStruct describes a format entirely in its type, e.g.
+ *
+ *   using Header = StaticStruct<StaticField<"magic", Int32ul>,
+ *                               StaticField<"count", Int16ub>,
+ *                               StaticField<"name", CString8l>>;
+ *
+ * Fields use the primitives of number.hpp and string.hpp as type tags, as
+ * well as StaticArray and nested StaticStructs. Primitives of basic.hpp and
+ * PaddedString take their size or value as an argument of create, here they
+ * have tags taking it as a template argument instead: StaticConst,
+ * StaticBytesConst, StaticBytes, StaticPadding and StaticPaddedString. Enum,
+ * and nodes depending on other fields, have no static counterpart. The parsed
+ * values are kept in
+ * a plain std::tuple (Header::value_type) and every field is parsed and built
+ * by inlined code without virtual calls, std::function or std::any. Offsets
+ * of all fields in front of the first dynamically sized one are constexpr,
+ * and fixed size structs are read and written with a single bulk copy.
+ *
+ * Static<Header> wraps a static schema into a Base node, so it can be used in
+ * a dynamic tree, e.g. as a Switch case.
+ * */
+
+template <size_t N> struct FixedString {
+  char data[N]{};
+  constexpr FixedString(const char (&s)[N]) { std::copy_n(s, N, data); }
+  constexpr std::string_view view() const { return {data, N - 1}; }
+};
+
+/*
+ * StaticCodec<T> parses and builds values of the type tag T:
+ *
+ * - value_type: the parsed value
+ * - fixed, size: whether T has a static size and what it is
+ * - parse, build, size_of: work on cursors for every T
+ * - decode, encode: work on the size bytes at a pointer, only if fixed. The
+ *   offset passed to decode is the absolute offset of the bytes, for errors.
+ *
+ * StaticStruct and StaticArray are their own codecs.
+ * */
+template <typename T> struct StaticCodec : T {};
+
+/*
+ * A constant number, stored with native byte order like Const. Unlike Const
+ * it is checked on parse, as the value of a field does not carry it, and
+ * build always writes Value.
+ * */
+template <auto Value> struct StaticConst {};
+// a constant string of bytes like BytesConst
+template <FixedString Value> struct StaticBytesConst {};
+// N raw bytes like Bytes, stored in a std::array
+template <size_t N> struct StaticBytes {};
+// N zero bytes like Padding, there is no value to keep
+template <size_t N> struct StaticPadding {};
+// a string of N bytes like PaddedString
+template <size_t N, typename TStringType = std::string,
+          std::endian Endianess = std::endian::native>
+struct StaticPaddedString {};
+
+// converts between the UTF-8 values and the stored strings, like String does
+template <typename TStringType>
+inline std::string static_to_utf8(const TStringType &s) {
+  if constexpr (std::is_same<std::u16string, TStringType>()) {
+    return Utf32To8(Utf16To32(s));
+  } else if constexpr (std::is_same<std::u32string, TStringType>()) {
+    return Utf32To8(s);
+  } else {
+    return s;
+  }
+}
+template <typename TStringType>
+inline TStringType static_from_utf8(const std::string &s) {
+  if constexpr (std::is_same<std::u16string, TStringType>()) {
+    return Utf32To16(Utf8To32(s));
+  } else if constexpr (std::is_same<std::u32string, TStringType>()) {
+    return Utf8To32(s);
+  } else {
+    return s;
+  }
+}
+
+template <typename TNumberType, std::endian Endianess>
+struct StaticCodec<NumberType<TNumberType, Endianess>> {
+  typedef TNumberType value_type;
+  static constexpr bool fixed = true;
+  static constexpr size_t size = sizeof(TNumberType);
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    value = cursor.read<TNumberType, Endianess>();
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    cursor.write<TNumberType, Endianess>(value);
+  }
+  static size_t size_of(const value_type &) { return size; }
+
+  static void decode(const std::byte *data, size_t, value_type &value) {
+    std::memcpy(&value, data, size);
+    value = swap_endian<Endianess>(value);
+  }
+  static void encode(std::byte *data, const value_type &value) {
+    TNumberType v = swap_endian<Endianess>(value);
+    std::memcpy(data, &v, size);
+  }
+};
+
+template <typename TStringType, std::endian Endianess>
+struct StaticCodec<CString<TStringType, Endianess>> {
+  typedef std::string value_type;
+  typedef typename TStringType::value_type TChar;
+  static constexpr bool fixed = false;
+  static constexpr size_t size = 0;
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    if constexpr (std::is_same<std::string, TStringType>()) {
+      auto rest = cursor.buffer().subspan(cursor.tell());
+      auto end = std::find(rest.begin(), rest.end(), std::byte{0});
+      value.assign(reinterpret_cast<const char *>(rest.data()),
+                   end - rest.begin());
+      cursor.skip(std::min(value.size() + 1, rest.size()));
+    } else {
+      TStringType s;
+      while (cursor.remaining() >= sizeof(TChar)) {
+        TChar c = cursor.read<TChar, Endianess>();
+        if (c == 0) {
+          break;
+        }
+        s.push_back(c);
+      }
+      value = static_to_utf8(s);
+    }
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    if constexpr (std::is_same<std::string, TStringType>()) {
+      cursor.write(value.c_str(), value.size() + 1);
+    } else {
+      auto s = static_from_utf8<TStringType>(value);
+      cursor.write_array<TChar, Endianess>(s.data(), s.size());
+      cursor.write<TChar>(0);
+    }
+  }
+  static size_t size_of(const value_type &value) {
+    return (static_from_utf8<TStringType>(value).size() + 1) * sizeof(TChar);
+  }
+};
+
+/*
+ * The length is stored in bytes by TLengthType, like PascalString does.
+ * */
+template <typename TStringType, typename TLengthType, std::endian Endianess>
+struct StaticCodec<PascalString<TStringType, TLengthType, Endianess>> {
+  typedef std::string value_type;
+  typedef typename TStringType::value_type TChar;
+  typedef StaticCodec<TLengthType> length_codec;
+  static constexpr bool fixed = false;
+  static constexpr size_t size = 0;
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    typename length_codec::value_type length;
+    length_codec::parse(cursor, length);
+    TStringType s(length / sizeof(TChar), 0);
+    cursor.read_array<TChar, Endianess>(s.data(), s.size());
+    value = static_to_utf8(s);
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    auto s = static_from_utf8<TStringType>(value);
+    length_codec::build(cursor, s.size() * sizeof(TChar));
+    cursor.write_array<TChar, Endianess>(s.data(), s.size());
+  }
+  static size_t size_of(const value_type &value) {
+    return length_codec::size +
+           static_from_utf8<TStringType>(value).size() * sizeof(TChar);
+  }
+};
+
+template <auto Value> struct StaticCodec<StaticConst<Value>> {
+  typedef decltype(Value) value_type;
+  static constexpr bool fixed = true;
+  static constexpr size_t size = sizeof(value_type);
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    size_t offset = cursor.tell();
+    decode(cursor.read(size).data(), offset, value);
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    encode(cursor.claim(size).data(), value);
+  }
+  static size_t size_of(const value_type &) { return size; }
+
+  static void decode(const std::byte *data, size_t offset, value_type &value) {
+    std::memcpy(&value, data, size);
+    if (value != Value) {
+      throw ParseFailure(offset, "Const: expected " + std::to_string(Value) +
+                                     ", got " + std::to_string(value));
+    }
+  }
+  static void encode(std::byte *data, const value_type &) {
+    value_type v = Value;
+    std::memcpy(data, &v, size);
+  }
+};
+
+template <FixedString Value> struct StaticCodec<StaticBytesConst<Value>> {
+  typedef std::string value_type;
+  static constexpr bool fixed = true;
+  static constexpr size_t size = Value.view().size();
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    size_t offset = cursor.tell();
+    decode(cursor.read(size).data(), offset, value);
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    encode(cursor.claim(size).data(), value);
+  }
+  static size_t size_of(const value_type &) { return size; }
+
+  static void decode(const std::byte *data, size_t offset, value_type &value) {
+    value.assign(reinterpret_cast<const char *>(data), size);
+    if (value != Value.view()) {
+      throw ParseFailure(offset, "BytesConst: expected " +
+                                     std::string(Value.view()) + ", got " +
+                                     value);
+    }
+  }
+  static void encode(std::byte *data, const value_type &) {
+    if constexpr (size != 0) {
+      std::memcpy(data, Value.data, size);
+    }
+  }
+};
+
+template <size_t N> struct StaticCodec<StaticBytes<N>> {
+  typedef std::array<uint8_t, N> value_type;
+  static constexpr bool fixed = true;
+  static constexpr size_t size = N;
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    cursor.read(value.data(), size);
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    cursor.write(value.data(), size);
+  }
+  static size_t size_of(const value_type &) { return size; }
+
+  static void decode(const std::byte *data, size_t, value_type &value) {
+    if constexpr (size != 0) {
+      std::memcpy(value.data(), data, size);
+    }
+  }
+  static void encode(std::byte *data, const value_type &value) {
+    if constexpr (size != 0) {
+      std::memcpy(data, value.data(), size);
+    }
+  }
+};
+
+template <size_t N> struct StaticCodec<StaticPadding<N>> {
+  typedef std::monostate value_type;
+  static constexpr bool fixed = true;
+  static constexpr size_t size = N;
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    size_t offset = cursor.tell();
+    decode(cursor.read(size).data(), offset, value);
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    encode(cursor.claim(size).data(), value);
+  }
+  static size_t size_of(const value_type &) { return size; }
+
+  static void decode(const std::byte *data, size_t offset, value_type &) {
+    for (size_t i = 0; i < size; i++) {
+      if (data[i] != std::byte{0}) {
+        throw ParseFailure(offset + i, "Padding: expected 0");
+      }
+    }
+  }
+  static void encode(std::byte *data, const value_type &) {
+    if constexpr (size != 0) {
+      std::memset(data, 0, size);
+    }
+  }
+};
+
+/*
+ * Like PaddedString, the value keeps all N bytes, including the padding, and
+ * build fills up shorter values with zeros.
+ * */
+template <size_t N, typename TStringType, std::endian Endianess>
+struct StaticCodec<StaticPaddedString<N, TStringType, Endianess>> {
+  typedef std::string value_type;
+  typedef typename TStringType::value_type TChar;
+  static_assert(N % sizeof(TChar) == 0,
+                "StaticPaddedString: size is not a multiple of the char size");
+  static constexpr bool fixed = true;
+  static constexpr size_t size = N;
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    size_t offset = cursor.tell();
+    decode(cursor.read(size).data(), offset, value);
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    encode(cursor.claim(size).data(), value);
+  }
+  static size_t size_of(const value_type &) { return size; }
+
+  static void decode(const std::byte *data, size_t, value_type &value) {
+    TStringType s(N / sizeof(TChar), 0);
+    if constexpr (size != 0) {
+      std::memcpy(s.data(), data, size);
+    }
+    swap_endian_n<Endianess>(s.data(), s.size());
+    value = static_to_utf8(s);
+  }
+  static void encode(std::byte *data, const value_type &value) {
+    auto s = static_from_utf8<TStringType>(value);
+    custom_assert(s.size() * sizeof(TChar) <= size);
+    s.resize(N / sizeof(TChar));
+    swap_endian_n<Endianess>(s.data(), s.size());
+    if constexpr (size != 0) {
+      std::memcpy(data, s.data(), size);
+    }
+  }
+};
+
+template <FixedString Name, typename T> struct StaticField {
+  static constexpr std::string_view name = Name.view();
+  typedef StaticCodec<T> codec;
+
+  template <size_t I, typename TValue> static auto &access(TValue &value) {
+    return std::get<I>(value);
+  }
+};
+
+/*
+ * A fixed number of elements of the type tag T, stored in a std::array.
+ * */
+template <typename T, size_t N> struct StaticArray {
+  typedef StaticCodec<T> codec;
+  typedef std::array<typename codec::value_type, N> value_type;
+  static constexpr bool fixed = codec::fixed;
+  static constexpr size_t size = codec::size * N;
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    if constexpr (fixed) {
+      size_t offset = cursor.tell();
+      decode(cursor.read(size).data(), offset, value);
+    } else {
+      for (auto &v : value) {
+        codec::parse(cursor, v);
+      }
+    }
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    if constexpr (fixed) {
+      encode(cursor.claim(size).data(), value);
+    } else {
+      for (auto &v : value) {
+        codec::build(cursor, v);
+      }
+    }
+  }
+  static size_t size_of(const value_type &value) {
+    if constexpr (fixed) {
+      return size;
+    } else {
+      size_t ret = 0;
+      for (auto &v : value) {
+        ret += codec::size_of(v);
+      }
+      return ret;
+    }
+  }
+
+  static void decode(const std::byte *data, size_t offset, value_type &value) {
+    for (size_t i = 0; i < N; i++) {
+      codec::decode(data + i * codec::size, offset + i * codec::size,
+                    value[i]);
+    }
+  }
+  static void encode(std::byte *data, const value_type &value) {
+    for (size_t i = 0; i < N; i++) {
+      codec::encode(data + i * codec::size, value[i]);
+    }
+  }
+};
+
+/*
+ * The fields of a StaticStruct or Binding, stored in a TValue. Every field
+ * reaches its value in TValue through access.
+ * */
+template <typename TValue, typename... Fields> struct StaticRecord {
+  typedef TValue value_type;
+  static constexpr size_t field_count = sizeof...(Fields);
+  static constexpr std::array<std::string_view, field_count> names = {
+      Fields::name...};
+  static constexpr bool fixed = (Fields::codec::fixed && ...);
+  static constexpr size_t size = fixed ? (Fields::codec::size + ... + 0) : 0;
+
+  /*
+   * Returns the index of the field, fails to compile if there is none.
+   * */
+  template <FixedString Name> static consteval size_t index() {
+    for (size_t i = 0; i < field_count; i++) {
+      if (names[i] == Name.view()) {
+        return i;
+      }
+    }
+    throw "StaticStruct: no such field";
+  }
+
+  /*
+   * Returns the offset of the field relative to the struct, only compiles if
+   * all fields in front of it have a static size.
+   * */
+  template <FixedString Name> static consteval size_t offset() {
+    constexpr std::array<bool, field_count> fixeds = {Fields::codec::fixed...};
+    constexpr std::array<size_t, field_count> sizes = {Fields::codec::size...};
+    size_t ret = 0;
+    for (size_t i = 0; i < index<Name>(); i++) {
+      if (!fixeds[i]) {
+        throw "StaticStruct: offset behind a dynamically sized field";
+      }
+      ret += sizes[i];
+    }
+    return ret;
+  }
+
+  template <FixedString Name> static auto &get(value_type &value) {
+    constexpr size_t i = index<Name>();
+    return field_at<i>::template access<i>(value);
+  }
+  template <FixedString Name>
+  static const auto &get(const value_type &value) {
+    constexpr size_t i = index<Name>();
+    return field_at<i>::template access<i>(value);
+  }
+
+  static void parse(InputCursor &cursor, value_type &value) {
+    if constexpr (fixed) {
+      size_t offset = cursor.tell();
+      decode(cursor.read(size).data(), offset, value);
+    } else {
+      parse_fields(cursor, value, std::index_sequence_for<Fields...>());
+    }
+  }
+  static void build(OutputCursor &cursor, const value_type &value) {
+    if constexpr (fixed) {
+      encode(cursor.claim(size).data(), value);
+    } else {
+      build_fields(cursor, value, std::index_sequence_for<Fields...>());
+    }
+  }
+  static size_t size_of(const value_type &value) {
+    if constexpr (fixed) {
+      return size;
+    } else {
+      return size_of_fields(value, std::index_sequence_for<Fields...>());
+    }
+  }
+
+  static void decode(const std::byte *data, size_t offset, value_type &value) {
+    decode_fields(data, offset, value, std::index_sequence_for<Fields...>());
+  }
+  static void encode(std::byte *data, const value_type &value) {
+    encode_fields(data, value, std::index_sequence_for<Fields...>());
+  }
+
+  /*
+   * Returns the value of the field with the given name, for lookups from a
+   * dynamic tree.
+   * */
+  static std::any get(const value_type &value, std::string_view key) {
+    return get_field(value, key, std::index_sequence_for<Fields...>());
+  }
+
+protected:
+  template <size_t I>
+  using field_at = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+  // offset of every field, only meaningful for fixed structs
+  static constexpr std::array<size_t, field_count> fixed_offsets() {
+    std::array<size_t, field_count> ret{};
+    constexpr std::array<size_t, field_count> sizes = {Fields::codec::size...};
+    for (size_t i = 1; i < field_count; i++) {
+      ret[i] = ret[i - 1] + sizes[i - 1];
+    }
+    return ret;
+  }
+
+  template <size_t... Is>
+  static void parse_fields(InputCursor &cursor, value_type &value,
+                           std::index_sequence<Is...>) {
+    (Fields::codec::parse(cursor, Fields::template access<Is>(value)), ...);
+  }
+  template <size_t... Is>
+  static void build_fields(OutputCursor &cursor, const value_type &value,
+                           std::index_sequence<Is...>) {
+    (Fields::codec::build(cursor, Fields::template access<Is>(value)), ...);
+  }
+  template <size_t... Is>
+  static size_t size_of_fields(const value_type &value,
+                               std::index_sequence<Is...>) {
+    return (Fields::codec::size_of(Fields::template access<Is>(value)) + ... +
+            0);
+  }
+  template <size_t... Is>
+  static void decode_fields(const std::byte *data, size_t offset,
+                            value_type &value, std::index_sequence<Is...>) {
+    constexpr auto offsets = fixed_offsets();
+    (Fields::codec::decode(data + offsets[Is], offset + offsets[Is],
+                           Fields::template access<Is>(value)),
+     ...);
+  }
+  template <size_t... Is>
+  static void encode_fields(std::byte *data, const value_type &value,
+                            std::index_sequence<Is...>) {
+    constexpr auto offsets = fixed_offsets();
+    (Fields::codec::encode(data + offsets[Is],
+                           Fields::template access<Is>(value)),
+     ...);
+  }
+  template <size_t... Is>
+  static std::any get_field(const value_type &value, std::string_view key,
+                            std::index_sequence<Is...>) {
+    std::any ret;
+    bool found = ((Fields::name == key
+                       ? (ret = Fields::template access<Is>(value), true)
+                       : false) ||
+                  ...);
+    if (!found) {
+      throw cpptrace::runtime_error("StaticStruct: " + std::string(key) +
+                                    " not found!");
+    }
+    return ret;
+  }
+};
+
+template <typename... Fields>
+struct StaticStruct
+    : StaticRecord<std::tuple<typename Fields::codec::value_type...>,
+                   Fields...> {};
+
+/*
+ * Static wraps a compile-time schema into a node of the dynamic tree. The
+ * parsed values are accessible through value and get(key).
+ * */
+template <typename TStatic> class Static : public Base {
+public:
+  typedef StaticCodec<TStatic> codec;
+  typedef typename codec::value_type value_type;
+
+  using Base::get;
+  using Base::get_field;
+  using Base::get_offset;
+  using Base::parse;
+  using Base::build;
+  value_type value{};
+
+  Static(PrivateBase) : Base(PrivateBase()) {}
+  static std::shared_ptr<Static> create() {
+    return make_node<Static>(PrivateBase());
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<Static>(*this);
+    ret->value = {};
+    return ret;
+  }
+
+  size_t get_size() override { return codec::size_of(value); }
+  bool size_memoized() override { return codec::fixed; }
+  std::optional<size_t> fixed_size() override {
+    if constexpr (codec::fixed) {
+      return codec::size;
+    }
+    return std::nullopt;
+  }
+
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Static::parse", name, idx, cursor);
+    codec::parse(cursor, value);
+    return result(value);
+  }
+
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    codec::build(cursor, value);
+  }
+
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    if constexpr (codec::fixed) {
+      cached_offset = offset;
+      codec::decode(data, offset, value);
+      return result(value);
+    }
+    return Base::parse_fixed(data, offset);
+  }
+
+  void build_fixed(std::byte *data, size_t offset) override {
+    if constexpr (codec::fixed) {
+      cached_offset = offset;
+      codec::encode(data, value);
+    } else {
+      Base::build_fixed(data, offset);
+    }
+  }
+
+  bool has_field_nodes() override { return false; }
+
+  std::any get() override { return value; }
+  std::any get(std::string key) override { return codec::get(value, key); }
+  void set(std::any v) override {
+    value = std::any_cast<value_type>(v);
+    size_changed();
+  }
+};
+
+} // namespace etcetera
@@ -7,18 +7,50 @@ namespace etcetera {
 
 class String : public Base {
 protected:
+  // the value the memoized size belongs to
+  std::string sized_value;
+
+  /*
+   * Like size_cache_hit, but value may have been assigned directly since the
+   * size was memoized. Then everything behind the string moved.
+   * */
+  bool value_size_cache_hit() {
+    if (cached_size && value != sized_value) {
+      size_changed();
+    }
+    return size_cache_hit();
+  }
+
+  size_t memoize_value_size(size_t size) {
+    cached_size = size;
+    sized_value = value;
+    return size;
+  }
+
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
   std::string value;
   String(PrivateBase) : Base(PrivateBase()) {}
 
   std::any get() override { return value; }
+  ValueView value_view() override { return &value; }
+  void set(std::any value) override {
+    this->value = std::any_cast<std::string>(value);
+    size_changed();
+  }
 
   bool is_simple_type() override { return true; }
 
+  // the size follows value, which can be assigned without size_changed, so
+  // containers must not memoize their size over it
+  bool size_memoized() override { return false; }
+
   void parse_xml(pugi::xml_node const &node, std::string name, bool) override {
     value = node.attribute(name.c_str()).as_string();
+    cached_size.reset();
   }
 
   pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
@@ -33,13 +65,22 @@ class CString : public String {
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
   using Base::get_offset;
   CString(Base::PrivateBase) : String(PrivateBase()) {}
   static std::shared_ptr<CString> create() {
-    return std::make_shared<CString>(PrivateBase());
+    return make_node<CString>(PrivateBase());
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    return make_node<CString>(*this);
   }
 
   size_t get_size() override {
+    if (value_size_cache_hit()) {
+      return cached_size.value();
+    }
     TStringType s;
     if constexpr (std::is_same<std::u16string, TStringType>()) {
       // FIXME: this is a hack
@@ -49,7 +90,8 @@ public:
     } else {
       s = this->value;
     }
-    return (s.length() + 1) * sizeof(typename TStringType::value_type);
+    return memoize_value_size((s.length() + 1) *
+                              sizeof(typename TStringType::value_type));
   }
 
   size_t length() override {
@@ -65,22 +107,19 @@ public:
     return s.length();
   }
 
-  std::any parse(std::istream &stream) override {
-    union {
-      typename TStringType::value_type c;
-      char bytes[sizeof(typename TStringType::value_type)];
-    } data;
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("CString::parse", name, idx, cursor);
+    cached_size.reset();
+    typedef typename TStringType::value_type TChar;
     TStringType s;
-    s.clear();
-    while (stream.read(data.bytes, sizeof(typename TStringType::value_type))) {
-      if constexpr (Endianess != std::endian::native) {
-        data.c = std::byteswap(data.c);
-      }
+    while (cursor.remaining() >= sizeof(TChar)) {
+      TChar c = cursor.read<TChar, Endianess>();
       // std::string always includes a null terminator
-      if (data.c == 0) {
+      if (c == 0) {
         break;
       }
-      s.push_back(data.c);
+      s.push_back(c);
     }
     if constexpr (std::is_same<std::u16string, TStringType>()) {
       // FIXME: this is a hack
@@ -90,9 +129,10 @@ public:
     } else {
       this->value = s;
     }
-    return this->value;
+    return result(this->value);
   }
-  void build(std::iostream &stream) override {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
     TStringType s;
     if constexpr (std::is_same<std::u16string, TStringType>()) {
       // FIXME: this is a hack
@@ -102,14 +142,11 @@ public:
     } else {
       s = this->value;
     }
-    for (auto &c : s) {
-      if constexpr (Endianess != std::endian::native) {
-        c = std::byteswap(c);
-      }
-      stream.write((char *)&c, sizeof(typename TStringType::value_type));
+    typedef typename TStringType::value_type TChar;
+    for (auto c : s) {
+      cursor.write<TChar, Endianess>(c);
     }
-    typename TStringType::value_type c = 0;
-    stream.write((char *)&c, sizeof(typename TStringType::value_type));
+    cursor.write<TChar>(0);
   }
 };
 using CString8l = CString<std::string, std::endian::little>;
@@ -130,19 +167,32 @@ protected:
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
   using Base::get_offset;
   PaddedString(Base::PrivateBase, FSizeFn size_fn, size_t size)
       : String(PrivateBase()), size_fn(size_fn), size(size) {}
   static std::shared_ptr<PaddedString> create(FSizeFn size_fn) {
-    return std::make_shared<PaddedString>(PrivateBase(), size_fn, 0);
+    if (auto size = constant_of(size_fn)) {
+      return create(size.value());
+    }
+    return make_node<PaddedString>(PrivateBase(), size_fn, 0);
   }
   static std::shared_ptr<PaddedString> create(size_t size) {
-    return std::make_shared<PaddedString>(PrivateBase(), nullptr, size);
+    return make_node<PaddedString>(PrivateBase(), nullptr, size);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    return make_node<PaddedString>(*this);
+  }
+
+  std::vector<std::vector<std::string>> dependencies() override {
+    return fields_of(size_fn);
   }
 
   size_t get_size() override {
     if (size_fn) {
-      size = size_fn(this->parent);
+      size = call(size_fn);
     }
     if constexpr (std::is_same<std::u16string, TStringType>()) {
       custom_assert(size % sizeof(char16_t) == 0);
@@ -151,6 +201,7 @@ public:
     }
     return size;
   }
+  bool size_memoized() override { return !size_fn; }
 
   size_t length() override {
     TStringType s;
@@ -165,22 +216,15 @@ public:
     return s.length();
   }
 
-  std::any parse(std::istream &stream) override {
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("PaddedString::parse", name, idx, cursor);
     get_size();
-    union {
-      typename TStringType::value_type c;
-      char bytes[sizeof(typename TStringType::value_type)];
-    } data;
+    typedef typename TStringType::value_type TChar;
     TStringType s;
-    s.clear();
-    int64_t old_offset = stream.tellg();
-    while ((int64_t)stream.tellg() < (old_offset + (int64_t)size)) {
-      custom_assert(stream.tellg() >= 0);
-      stream.read(data.bytes, sizeof(typename TStringType::value_type));
-      if constexpr (Endianess != std::endian::native) {
-        data.c = std::byteswap(data.c);
-      }
-      s.push_back(data.c);
+    size_t end_offset = cursor.tell() + size;
+    while (cursor.tell() < end_offset) {
+      s.push_back(cursor.read<TChar, Endianess>());
     }
     if constexpr (std::is_same<std::u16string, TStringType>()) {
       // FIXME: this is a hack
@@ -190,9 +234,10 @@ public:
     } else {
       this->value = s;
     }
-    return this->value;
+    return result(this->value);
   }
-  void build(std::iostream &stream) override {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
     get_size();
     TStringType s;
     if constexpr (std::is_same<std::u16string, TStringType>()) {
@@ -203,19 +248,14 @@ public:
     } else {
       s = this->value;
     }
-    int64_t old_offset = stream.tellp();
-    for (auto &c : s) {
-      if constexpr (Endianess != std::endian::native) {
-        c = std::byteswap(c);
-      }
-      stream.write((char *)&c, sizeof(typename TStringType::value_type));
-    }
-    spdlog::debug("PaddedString::build assert {} {} {}", this->value,
-                  (size_t)stream.tellp() - old_offset, size);
-    custom_assert(((int64_t)stream.tellp() - old_offset) <= (int64_t)size);
-    for (size_t i = 0; i < size - (stream.tellp() - old_offset); i++) {
-      stream.write("\0", 1);
+    typedef typename TStringType::value_type TChar;
+    size_t old_offset = cursor.tell();
+    for (auto c : s) {
+      cursor.write<TChar, Endianess>(c);
     }
+    size_t written = cursor.tell() - old_offset;
+    custom_assert(written <= size);
+    cursor.skip(size - written);
   }
 };
 
@@ -235,15 +275,27 @@ protected:
 public:
   using Base::get;
   using Base::get_field;
+  using Base::parse;
+  using Base::build;
   using Base::get_offset;
   PascalString(Base::PrivateBase, std::shared_ptr<TLengthType> length_type)
       : String(PrivateBase()), length_type(length_type) {}
   static std::shared_ptr<PascalString>
   create(std::shared_ptr<TLengthType> length_type) {
-    return std::make_shared<PascalString>(PrivateBase(), length_type);
+    return make_node<PascalString>(PrivateBase(), length_type);
+  }
+
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<PascalString>(*this);
+    ret->length_type =
+        std::static_pointer_cast<TLengthType>(length_type->clone());
+    return ret;
   }
 
   size_t get_size() override {
+    if (value_size_cache_hit()) {
+      return cached_size.value();
+    }
     TStringType s;
     size_t size = this->value.length();
     if constexpr (std::is_same<std::u16string, TStringType>()) {
@@ -254,7 +306,7 @@ public:
       size = s.length() * sizeof(char32_t);
     }
 
-    return size + length_type->get_size();
+    return memoize_value_size(size + length_type->get_size());
   }
 
   size_t length() override {
@@ -270,27 +322,19 @@ public:
     return s.length();
   }
 
-  std::any parse(std::istream &stream) override {
-    length_type->parse(stream);
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("PascalString::parse", name, idx, cursor);
+    cached_size.reset();
+    length_type->parse(cursor);
     size_t size = length_type->value;
 
+    typedef typename TStringType::value_type TChar;
     TStringType s;
-    union {
-      typename TStringType::value_type c;
-      char bytes[sizeof(typename TStringType::value_type)];
-    } data;
-
-    s.clear();
-    int64_t old_offset = stream.tellg();
-    while ((int64_t)stream.tellg() < (old_offset + (int64_t)size)) {
-      custom_assert(stream.tellg() >= 0);
-      stream.read(data.bytes, sizeof(typename TStringType::value_type));
-      if constexpr (Endianess != std::endian::native) {
-        data.c = std::byteswap(data.c);
-      }
-      s.push_back(data.c);
+    size_t end_offset = cursor.tell() + size;
+    while (cursor.tell() < end_offset) {
+      s.push_back(cursor.read<TChar, Endianess>());
     }
-    spdlog::debug("PascalString::parse {} {}", (size_t)stream.tellg(), size);
     if constexpr (std::is_same<std::u16string, TStringType>()) {
       // FIXME: this is a hack
       this->value = Utf32To8(Utf16To32(s));
@@ -299,10 +343,11 @@ public:
     } else {
       this->value = s;
     }
-    return this->value;
+    return result(this->value);
   }
 
-  void build(std::iostream &stream) override {
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
     TStringType s;
     size_t len = 0;
     if constexpr (std::is_same<std::u16string, TStringType>()) {
@@ -315,24 +360,17 @@ public:
       s = this->value;
       len = s.length();
     }
-    spdlog::debug("PascalString::build {} {} {}", this->value, len,
-                  length_type->get_size());
-
-    int64_t old_offset = stream.tellp();
+    size_t old_offset = cursor.tell();
     // value is std::string so the length is in bytes even if it is utf-16 or 32
     length_type->value = len;
-    length_type->build(stream);
+    length_type->build(cursor);
     size_t size = len + length_type->get_size();
 
-    for (auto &c : s) {
-      if constexpr (Endianess != std::endian::native) {
-        c = std::byteswap(c);
-      }
-      stream.write((char *)&c, sizeof(typename TStringType::value_type));
+    typedef typename TStringType::value_type TChar;
+    for (auto c : s) {
+      cursor.write<TChar, Endianess>(c);
     }
-    spdlog::debug("PascalString::build assert {} {} {}", this->value,
-                  (size_t)stream.tellp() - old_offset, size);
-    custom_assert(((int64_t)stream.tellp() - old_offset) == (int64_t)size);
+    custom_assert(cursor.tell() - old_offset == size);
   }
 };
 
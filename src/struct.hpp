@@ -8,59 +8,212 @@ typedef std::pair<std::string, std::shared_ptr<Base>> Field;
 
 class Struct : public Base {
   tsl::ordered_map<std::string, std::shared_ptr<Base>> fields;
+  // per field: number of fields and bytes of the fixed layout run starting
+  // there, 0 for dynamic fields
+  std::vector<size_t> run_fields;
+  std::vector<size_t> run_bytes;
+
+  /*
+   * Finds the runs of fixed layout fields, which are parsed and built with a
+   * single bulk copy.
+   * */
+  void update_layout() {
+    run_fields.assign(fields.size() + 1, 0);
+    run_bytes.assign(fields.size() + 1, 0);
+    for (size_t i = fields.size(); i-- > 0;) {
+      if (auto size = (fields.begin() + i)->second->fixed_size()) {
+        run_fields[i] = run_fields[i + 1] + 1;
+        run_bytes[i] = run_bytes[i + 1] + size.value();
+      }
+    }
+  }
+
+  /*
+   * Parses the count fields starting at it from the bytes at data.
+   * */
+  void parse_run(decltype(fields)::iterator it, size_t count,
+                 const std::byte *data, size_t offset,
+                 tsl::ordered_map<std::string, std::any> &obj) {
+    for (; count > 0; count--, ++it) {
+      auto &[key, field] = *it;
+      try {
+        auto value = field->parse_fixed(data, offset);
+        if (collect_results) {
+          obj.emplace(key, std::move(value));
+        }
+      } catch (...) {
+        rethrow_at(key, offset);
+      }
+      size_t size = field->fixed_size().value();
+      data += size;
+      offset += size;
+    }
+  }
+
+  void build_run(decltype(fields)::iterator it, size_t count, std::byte *data,
+                 size_t offset) {
+    for (; count > 0; count--, ++it) {
+      auto &[key, field] = *it;
+      try {
+        field->build_fixed(data, offset);
+      } catch (...) {
+        rethrow_at<BuildFailure>(key, offset);
+      }
+      size_t size = field->fixed_size().value();
+      data += size;
+      offset += size;
+    }
+  }
+
+  /*
+   * Checks that the expressions of every field only read fields in front of
+   * it, the others are not parsed yet when it is.
+   * */
+  void check_dependencies() {
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+      for (auto &path : it->second->dependencies()) {
+        if (path.empty() || path[0] == "_") {
+          continue;
+        }
+        auto dep = fields.find(path[0]);
+        if (dep != fields.end() && dep - fields.begin() >= it - fields.begin()) {
+          throw cpptrace::runtime_error("Struct: " + it->first +
+                                        " depends on " + path[0] +
+                                        ", which is parsed after it");
+        }
+      }
+    }
+  }
 
 public:
   using Base::get;
   using Base::get_field;
   using Base::get_offset;
+  using Base::parse;
+  using Base::build;
   template <typename... Args>
   Struct(PrivateBase, Args &&...args) : Base(PrivateBase()) {
     (fields.emplace(std::get<0>(std::forward<Args>(args)),
                     std::get<1>(std::forward<Args>(args))),
      ...);
+    update_layout();
+    check_dependencies();
   }
   template <typename... Args>
   static std::shared_ptr<Struct> create(Args &&...args) {
-    auto ret = std::make_shared<Struct>(PrivateBase(), args...);
+    auto ret = make_node<Struct>(PrivateBase(), args...);
 
     for (auto &[key, field] : ret->fields) {
-      field->set_parent(ret);
+      field->set_parent(ret.get());
       field->set_name(key);
     }
 
     return ret;
   }
 
-  std::any parse(std::istream &stream) override {
+  std::shared_ptr<Base> clone() const override {
+    auto ret = make_node<Struct>(*this);
+    for (auto &[key, field] : ret->fields) {
+      ret->fields[key] = field->clone();
+      ret->fields[key]->set_parent(ret.get());
+    }
+    return ret;
+  }
+
+  std::any parse(InputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Struct::parse", name, idx, cursor);
     tsl::ordered_map<std::string, std::any> obj;
-    for (auto &[key, field] : fields) {
+    size_t i = 0;
+    for (auto it = fields.begin(); it != fields.end();) {
+      if (size_t count = run_fields[i]) {
+        ETCETERA_TRACE_SCOPE("Struct::parse_run", it->first, i, cursor);
+        size_t offset = cursor.tell();
+        std::span<const std::byte> bytes;
+        try {
+          bytes = cursor.read(run_bytes[i]);
+        } catch (...) {
+          rethrow_at(it->first, offset);
+        }
+        parse_run(it, count, bytes.data(), offset, obj);
+        it += count;
+        i += count;
+        continue;
+      }
+      auto &[key, field] = *it;
       try {
-        spdlog::debug("Struct::parse {:02X} {}", (size_t)stream.tellg(), key);
-        std::any value = field->parse(stream);
-        obj.emplace(key, value);
-      } catch (std::exception &e) {
-        throw std::runtime_error(name + "[" + key + "]->" +
-                                 std::string(e.what()));
+        std::any value = field->parse(cursor);
+        if (collect_results) {
+          obj.emplace(key, std::move(value));
+        }
+      } catch (...) {
+        rethrow_at(key, cursor.tell());
       }
+      ++it;
+      ++i;
     }
-    return obj;
+    // the size may have been memoized while the fields were parsed
+    cached_size.reset();
+    memoize_size();
+    return result(std::move(obj));
   }
 
-  void build(std::iostream &stream) override {
-    for (auto &[key, field] : fields) {
-      spdlog::debug("Struct::build_xml {} {}", (size_t)stream.tellp(), key);
+  void build(OutputCursor &cursor) override {
+    cached_offset = cursor.tell();
+    ETCETERA_TRACE_SCOPE("Struct::build", name, idx, cursor);
+    size_t i = 0;
+    for (auto it = fields.begin(); it != fields.end();) {
+      if (size_t count = run_fields[i]) {
+        size_t offset = cursor.tell();
+        build_run(it, count, cursor.claim(run_bytes[i]).data(), offset);
+        it += count;
+        i += count;
+        continue;
+      }
+      auto &[key, field] = *it;
       try {
-        field->build(stream);
-      } catch (std::exception &e) {
-        throw std::runtime_error(name + "[" + key + "]->" +
-                                 std::string(e.what()));
+        field->build(cursor);
+      } catch (...) {
+        rethrow_at<BuildFailure>(key, cursor.tell());
       }
+      ++it;
+      ++i;
+    }
+  }
+
+  std::optional<size_t> fixed_size() override {
+    if (run_fields[0] != fields.size()) {
+      return std::nullopt;
     }
+    return run_bytes[0];
+  }
+
+  std::any parse_fixed(const std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    tsl::ordered_map<std::string, std::any> obj;
+    parse_run(fields.begin(), fields.size(), data, offset, obj);
+    cached_size = run_bytes[0];
+    return result(std::move(obj));
+  }
+
+  void build_fixed(std::byte *data, size_t offset) override {
+    cached_offset = offset;
+    build_run(fields.begin(), fields.size(), data, offset);
   }
 
   bool is_struct() override { return true; }
 
+  void for_each_child(const std::function<void(Base &)> &fn) override {
+    for (auto &[_, field] : fields) {
+      fn(*field);
+    }
+  }
+
   size_t get_offset(std::string key) override {
+    auto it = fields.find(key);
+    if (it != fields.end() && it->second->offset_current()) {
+      return it->second->get_offset();
+    }
     size_t ret = get_offset();
     for (auto &[k, field] : fields) {
       if (k == key) {
@@ -72,15 +225,44 @@ public:
     return 0;
   }
 
+  void invalidate_offset() override {
+    Base::invalidate_offset();
+    for (auto &[key, field] : fields) {
+      field->invalidate_offset();
+    }
+  }
+
+  void invalidate_offsets_after(std::string key) override {
+    bool after = false;
+    for (auto &[k, field] : fields) {
+      if (after) {
+        field->invalidate_offset();
+      }
+      after = after || k == key;
+    }
+    // the fixed size of the field may have changed as well, e.g. of a
+    // NumberArray
+    update_layout();
+    size_changed();
+  }
+
   size_t get_size() override {
+    if (size_cache_hit()) {
+      return cached_size.value();
+    }
     size_t size = 0;
+    bool memoize = true;
     for (auto &[key, field] : fields) {
       try {
         size += field->get_size();
+        memoize = memoize && field->size_memoized();
       } catch (std::exception &e) {
         throw std::runtime_error(key + "->" + std::string(e.what()));
       }
     }
+    if (memoize) {
+      cached_size = size;
+    }
     return size;
   }
 
@@ -88,8 +270,12 @@ public:
     throw cpptrace::runtime_error("Struct: Not implemented");
   }
   std::any get(std::string key) {
+    auto it = fields.find(key);
+    if (it == fields.end()) {
+      throw cpptrace::runtime_error("Struct: " + key + " not found!");
+    }
     try {
-      return fields[key]->get();
+      return it->second->get();
     } catch (std::exception &e) {
       throw std::runtime_error(name + "[" + key + "]->" +
                                std::string(e.what()));
@@ -98,10 +284,32 @@ public:
 
   std::weak_ptr<Base> get_field(std::string key) override {
     if (key == "_") {
-      return this->parent;
+      return parent_weak();
+    }
+
+    auto it = fields.find(key);
+    if (it == fields.end()) {
+      throw cpptrace::runtime_error("Struct: " + key + " not found!");
     }
+    return it->second;
+  }
+
+  std::optional<size_t> field_index(std::string_view key) override {
+    if (key == "_") {
+      return parent_index;
+    }
+    auto it = fields.find(std::string(key));
+    if (it == fields.end()) {
+      return std::nullopt;
+    }
+    return it - fields.begin();
+  }
 
-    return fields[key];
+  Base *get_field_at(size_t index) override {
+    if (index == parent_index) {
+      return this->parent;
+    }
+    return (fields.begin() + index)->second.get();
   }
 
   void parse_xml(pugi::xml_node const &node, std::string name,
@@ -115,6 +323,7 @@ public:
         throw std::runtime_error(key + "->" + std::string(e.what()));
       }
     }
+    cached_size.reset();
   }
 
   pugi::xml_node build_xml(pugi::xml_node &parent, std::string name) override {
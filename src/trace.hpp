@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace etcetera {
+
+/*
+ * Structured tracing of parse and build.
+ *
+ * The ETCETERA_TRACE_SCOPE macro compiles to nothing, unless ETCETERA_TRACE
+ * is defined at build time (cmake -DETCETERA_TRACE=ON). Then every traced
+ * node records an event with its kind, name, index, offset, size and the
+ * time it took into a lock-free ring buffer, which keeps the latest
+ * trace::capacity events of all threads:
+ *
+ *   try {
+ *     root->parse(cursor);
+ *   } catch (std::exception &) {
+ *     trace::dump(std::cerr);
+ *   }
+ *
+ * The event of a node is recorded when it is done, so children come before
+ * their parents. depth gives the nesting and parent the id of the enclosing
+ * event, which path follows to tell apart fields of the same name.
+ * */
+namespace trace {
+
+struct Event {
+  // static string like "Struct::parse"
+  const char *kind = nullptr;
+  // name of the node, truncated
+  char name[32] = {};
+  size_t idx = 0;
+  size_t offset = 0;
+  size_t size = 0;
+  uint64_t duration_ns = 0;
+  // unique per event, parent is the id of the enclosing one or 0
+  uint64_t id = 0;
+  uint64_t parent = 0;
+  uint32_t depth = 0;
+};
+
+static constexpr size_t capacity = 1 << 14;
+
+/*
+ * Ring buffer of the latest events. Writers never block, they claim a slot
+ * with a single fetch_add. Every slot carries a sequence number, which is odd
+ * while a writer fills the slot and 2 * (n + 1) once it holds event n.
+ * A writer only takes its slot with a compare exchange, if no other writer
+ * is busy with it and it does not hold a newer event, otherwise the event is
+ * dropped. Readers skip slots which are overwritten while they copy them.
+ * */
+class RingBuffer {
+  static_assert(std::is_trivially_copyable_v<Event> &&
+                sizeof(Event) % sizeof(uint64_t) == 0);
+  static constexpr size_t words = sizeof(Event) / sizeof(uint64_t);
+
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    // the event, copied word by word, so racing copies are well defined
+    std::atomic<uint64_t> event[words] = {};
+  };
+  std::unique_ptr<Slot[]> slots{new Slot[capacity]};
+  std::atomic<uint64_t> head{0};
+
+public:
+  void push(const Event &event) {
+    uint64_t n = head.fetch_add(1, std::memory_order_relaxed);
+    auto &slot = slots[n % capacity];
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    if (seq & 1 || seq >= 2 * (n + 1) ||
+        !slot.seq.compare_exchange_strong(seq, 2 * n + 1,
+                                          std::memory_order_acquire)) {
+      return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    uint64_t data[words];
+    std::memcpy(data, &event, sizeof(Event));
+    for (size_t i = 0; i < words; i++) {
+      slot.event[i].store(data[i], std::memory_order_relaxed);
+    }
+    slot.seq.store(2 * (n + 1), std::memory_order_release);
+  }
+
+  /*
+   * Returns the recorded events, oldest first.
+   * */
+  std::vector<Event> events() const {
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+    std::vector<Event> ret;
+    ret.reserve(end - begin);
+    for (uint64_t n = begin; n < end; n++) {
+      auto &slot = slots[n % capacity];
+      if (slot.seq.load(std::memory_order_acquire) != 2 * (n + 1)) {
+        continue;
+      }
+      uint64_t data[words];
+      for (size_t i = 0; i < words; i++) {
+        data[i] = slot.event[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == 2 * (n + 1)) {
+        Event event;
+        std::memcpy(&event, data, sizeof(Event));
+        ret.push_back(event);
+      }
+    }
+    return ret;
+  }
+
+  void clear() {
+    uint64_t end = head.load(std::memory_order_acquire);
+    for (size_t i = 0; i < capacity; i++) {
+      // slots a writer is busy with are left to it
+      uint64_t seq = slots[i].seq.load(std::memory_order_relaxed);
+      if (!(seq & 1)) {
+        slots[i].seq.compare_exchange_strong(seq, 0,
+                                             std::memory_order_relaxed);
+      }
+    }
+    head.store(end, std::memory_order_release);
+  }
+};
+
+inline RingBuffer &buffer() {
+  static RingBuffer ret;
+  return ret;
+}
+
+inline std::vector<Event> events() { return buffer().events(); }
+inline void clear() { buffer().clear(); }
+
+/*
+ * Returns the path of the event like "[entries]->3->[name]", following the
+ * parents among events. The outermost event is left out like in a
+ * ParseError, parents that were overwritten already end the path.
+ * */
+inline std::string path(const std::vector<Event> &events, const Event &event) {
+  std::unordered_map<uint64_t, const Event *> by_id;
+  for (auto &e : events) {
+    by_id[e.id] = &e;
+  }
+  std::string ret;
+  for (const Event *e = &event; e && e->parent;) {
+    std::string element = e->name[0] ? "[" + std::string(e->name) + "]"
+                                     : std::to_string(e->idx);
+    ret = ret.empty() ? element : element + "->" + ret;
+    auto it = by_id.find(e->parent);
+    e = it != by_id.end() ? it->second : nullptr;
+  }
+  return ret;
+}
+
+inline void dump(std::ostream &out) {
+  auto recorded = events();
+  for (auto &event : recorded) {
+    out << std::string(event.depth * 2, ' ') << event.kind << " "
+        << path(recorded, event) << " offset " << event.offset << " size "
+        << event.size << " " << event.duration_ns << "ns\n";
+  }
+}
+
+// nesting of the active scopes on this thread
+inline thread_local uint32_t depth = 0;
+// id of the innermost active scope on this thread
+inline thread_local uint64_t current = 0;
+inline std::atomic<uint64_t> next_id{1};
+
+/*
+ * Records an event for the lifetime of the scope, the size is the distance
+ * the cursor moved.
+ * */
+template <typename TCursor> class Scope {
+  TCursor &cursor;
+  Event event;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  Scope(const char *kind, std::string_view name, size_t idx, TCursor &cursor)
+      : cursor(cursor), start(std::chrono::steady_clock::now()) {
+    event.kind = kind;
+    auto n = std::min(name.size(), sizeof(event.name) - 1);
+    std::memcpy(event.name, name.data(), n);
+    event.idx = idx;
+    event.offset = cursor.tell();
+    event.depth = depth++;
+    event.id = next_id.fetch_add(1, std::memory_order_relaxed);
+    event.parent = current;
+    current = event.id;
+  }
+  ~Scope() {
+    depth--;
+    current = event.parent;
+    auto end = cursor.tell();
+    event.size = end > event.offset ? end - event.offset : 0;
+    event.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    buffer().push(event);
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+};
+
+} // namespace trace
+} // namespace etcetera
+
+#define ETCETERA_TRACE_CONCAT_(a, b) a##b
+#define ETCETERA_TRACE_CONCAT(a, b) ETCETERA_TRACE_CONCAT_(a, b)
+
+#ifdef ETCETERA_TRACE
+#define ETCETERA_TRACE_SCOPE(kind, name, idx, cursor)                          \
+  ::etcetera::trace::Scope ETCETERA_TRACE_CONCAT(trace_scope_, __LINE__)(      \
+      kind, name, idx, cursor)
+#else
+#define ETCETERA_TRACE_SCOPE(kind, name, idx, cursor) ((void)0)
+#endif
@@ -0,0 +1,49 @@
+#include "array.hpp"
+#include "number.hpp"
+#include "schema.hpp"
+#include "struct.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+using namespace etcetera;
+
+TEST_CASE("Nodes are created in the current arena") {
+  Arena arena;
+  REQUIRE(arena.allocated() == 0);
+  {
+    ArenaScope scope(arena);
+    auto field = Int32ul::create();
+    REQUIRE(arena.allocated() >= sizeof(Int32ul));
+  }
+  size_t before = arena.allocated();
+  auto heap = Int32ul::create();
+  REQUIRE(arena.allocated() == before);
+}
+
+TEST_CASE("Array parse into arena") {
+  std::vector<uint32_t> values(1000);
+  for (uint32_t i = 0; i < values.size(); i++) {
+    values[i] = i * 3;
+  }
+  uint32_t count = values.size();
+  std::vector<char> data(reinterpret_cast<char *>(&count),
+                         reinterpret_cast<char *>(&count) + sizeof(count));
+  data.insert(data.end(), reinterpret_cast<char *>(values.data()),
+              reinterpret_cast<char *>(values.data() + values.size()));
+
+  Schema schema(Struct::create(
+      Field("count", Int32ul::create()),
+      Field("values", Array::create(
+                          [](std::weak_ptr<Base> c) {
+                            return lock(c)->get<uint32_t>("count");
+                          },
+                          []() { return Int32ul::create(); }))));
+
+  Arena arena;
+  InputCursor cursor(data);
+  auto s = schema.parse(cursor, arena);
+  REQUIRE(current_arena == nullptr);
+  REQUIRE(arena.allocated() >= values.size() * sizeof(Int32ul));
+  REQUIRE(lock(s->get_field("values"))->length() == values.size());
+  REQUIRE(s->get<uint32_t>("values", 999) == 999 * 3);
+  REQUIRE(s->get_bytes() == data);
+}
@@ -2,9 +2,14 @@
 #include "basic.hpp"
 #include "helpers.hpp"
 #include "number.hpp"
+#include "parallel.hpp"
+#include "special.hpp"
+#include "string.hpp"
 #include "struct.hpp"
 #include <catch2/catch_test_macros.hpp>
 
+#include <numeric>
+
 using namespace etcetera;
 
 TEST_CASE("Array") {
@@ -132,3 +137,325 @@ TEST_CASE("RepeatUntil until size") {
   REQUIRE(f->get<uint32_t>(3) == 4);
   REQUIRE(f->get<uint32_t>(4) == 5);
 }
+
+TEST_CASE("NumberArray") {
+  std::stringstream data;
+  uint16_t a[6] = {0x0102, 0x0304, 0x0506, 0x0708, 0x090A, 0x0B0C};
+  data.write(reinterpret_cast<const char *>(a), sizeof(a));
+
+  auto arr = NumberArray<Int16ub>::create(6);
+  arr->parse(data);
+  REQUIRE(arr->length() == 6);
+  REQUIRE(arr->get_size() == sizeof(a));
+  REQUIRE(arr->values()[0] == 0x0201);
+  REQUIRE(arr->get<uint16_t>(5) == 0x0C0B);
+  REQUIRE(arr->get_offset(2) == 4);
+
+  std::stringstream ss;
+  arr->build(ss);
+  REQUIRE(ss.str() == data.str());
+}
+
+TEST_CASE("NumberArray in Struct") {
+  auto s = Struct::create(
+      Field("count", Int32ul::create()),
+      Field("values", NumberArray<Int32ul>::create([](std::weak_ptr<Base> c) {
+              return lock(c)->get<uint32_t>("count");
+            })),
+      Field("end", Int8ul::create()));
+
+  std::stringstream data;
+  uint32_t a[4] = {3, 10, 20, 30};
+  uint8_t end = 0xFF;
+  data.write(reinterpret_cast<const char *>(a), sizeof(a));
+  data.write(reinterpret_cast<const char *>(&end), sizeof(end));
+  s->parse(data);
+  REQUIRE(s->get<uint32_t>("values", 1) == 20);
+  REQUIRE(s->get_offset("end") == 16);
+
+  auto values = s->get_field<NumberArray<Int32ul>>("values").lock();
+  values->set(std::vector<uint32_t>{1, 2});
+  REQUIRE(s->get_size() == 13);
+  REQUIRE(s->get_offset("end") == 12);
+}
+
+TEST_CASE("NumberArray in a fixed Struct run resizes") {
+  auto s = Struct::create(Field("a", Int16ul::create()),
+                          Field("values", NumberArray<Int16ul>::create(2)),
+                          Field("b", Int16ul::create()));
+  REQUIRE(s->fixed_size() == 8);
+  std::vector<uint16_t> data = {1, 2, 3, 4};
+  InputCursor cursor(std::as_bytes(std::span(data)));
+  s->parse(cursor);
+
+  auto values = lock(s->get_field<NumberArray<Int16ul>>("values"));
+  values->set(std::vector<uint16_t>{5, 6, 7});
+  REQUIRE(values->fixed_size() == 6);
+  REQUIRE(s->fixed_size() == 10);
+  REQUIRE(s->get_offset("b") == 8);
+  std::vector<uint16_t> expected = {1, 5, 6, 7, 4};
+  auto bytes = s->get_bytes();
+  REQUIRE(bytes.size() == 10);
+  REQUIRE(std::memcmp(bytes.data(), expected.data(), 10) == 0);
+
+  pugi::xml_document doc;
+  auto node = doc.append_child("values");
+  for (int i = 0; i < 4; i++) {
+    node.append_child("values").append_attribute("values") = i;
+  }
+  values->parse_xml(node, "values", true);
+  REQUIRE(values->length() == 4);
+  REQUIRE(s->fixed_size() == 12);
+  REQUIRE(s->get_bytes().size() == 12);
+}
+
+TEST_CASE("Empty NumberArray and Padding in a fixed Struct run") {
+  auto s = Struct::create(Field("values", NumberArray<Int16ub>::create(0)),
+                          Field("pad", Padding::create(0)));
+  REQUIRE(s->fixed_size() == 0);
+  InputCursor cursor(std::span<const std::byte>{});
+  s->parse(cursor);
+  REQUIRE(lock(s->get_field<NumberArray<Int16ub>>("values"))->length() == 0);
+  OutputCursor out;
+  s->build(out);
+  REQUIRE(out.size() == 0);
+}
+
+TEST_CASE("Array elements reach their parents") {
+  auto s = Struct::create(
+      Field("size", Int8ul::create()),
+      Field("items", Array::create(
+                         [](std::weak_ptr<Base> c) {
+                           return lock(c)->get<uint8_t>("size");
+                         },
+                         []() {
+                           return Struct::create(
+                               Field("size", Int8ul::create()),
+                               Field("data",
+                                     Bytes::create([](std::weak_ptr<Base> c) {
+                                       return lock(c)->get<uint8_t>("size");
+                                     })));
+                         })));
+  std::stringstream data;
+  data.write("\x02\x01"
+             "a\x02"
+             "bc",
+             6);
+  s->parse(data);
+
+  auto item = lock(s->get_field<Base>("items", 1));
+  REQUIRE(item->get<std::vector<uint8_t>>("data") ==
+          std::vector<uint8_t>{'b', 'c'});
+  REQUIRE(lock(item->get_field("_")) == lock(s->get_field("items")));
+  item->invalidate_offset();
+  REQUIRE(item->get_offset() == 3);
+}
+
+TEST_CASE("LazyArray") {
+  auto s = Struct::create(
+      Field("count", Int8ul::create()),
+      Field("records", LazyArray::create(
+                           [](std::weak_ptr<Base> c) {
+                             return lock(c)->get<uint8_t>("count");
+                           },
+                           []() {
+                             return Struct::create(
+                                 Field("id", Int16ul::create()),
+                                 Field("value", Int8ul::create()));
+                           },
+                           2)),
+      Field("end", Int8ul::create()));
+  std::vector<uint8_t> buffer = {4, 1, 0, 10, 2, 0, 20, 3, 0, 30, 4, 0, 40, 99};
+  std::stringstream data;
+  data.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+  s->parse(data);
+
+  auto records = lock(s->get_field<LazyArray>("records"));
+  REQUIRE(records->length() == 4);
+  REQUIRE(records->get_size() == 12);
+  REQUIRE(records->cached() == 0);
+  REQUIRE(s->get<uint8_t>("end") == 99);
+
+  REQUIRE(s->get<uint16_t>("records", 2, "id") == 3);
+  REQUIRE(s->get<uint8_t>("records", 0, "value") == 10);
+  REQUIRE(records->cached() == 2);
+  REQUIRE(s->get_offset("records", 3) == 10);
+  REQUIRE(s->get<uint8_t>("records", 3, "value") == 40);
+  REQUIRE(records->cached() == 2);
+  // element 2 was dropped and is parsed again
+  REQUIRE(s->get<uint16_t>("records", 2, "id") == 3);
+  REQUIRE(lock(lock(records->get_field<Base>(2))->get_field("_")) == records);
+
+  auto record = lock(records->get_field<Base>(3));
+  lock(record->get_field("value"))->set(uint8_t(41));
+  std::stringstream out;
+  s->build(out);
+  buffer[12] = 41;
+  auto built = out.str();
+  REQUIRE(std::vector<uint8_t>(built.begin(), built.end()) == buffer);
+}
+
+TEST_CASE("LazyArray XML round trip") {
+  auto make = []() {
+    return LazyArray::create(
+        2,
+        []() {
+          return Struct::create(Field("a", Int32sl::create()),
+                                Field("b", Int16ul::create()));
+        },
+        1);
+  };
+  auto xml_str = R"(<root><test a="1" b="2"/><test a="-3" b="4"/>)"
+                 R"(<test a="5" b="6"/></root>)";
+  pugi::xml_document doc;
+  doc.load_string(xml_str);
+  auto arr = make();
+  arr->parse_xml(doc.child("root"), "test", false);
+  REQUIRE(arr->length() == 3);
+  REQUIRE(arr->get_size() == 18);
+  REQUIRE(arr->get<int32_t>(1, "a") == -3);
+  REQUIRE(arr->get<uint16_t>(2, "b") == 6);
+  REQUIRE(arr->cached() == 1);
+
+  pugi::xml_document out;
+  auto root = out.append_child("root");
+  arr->build_xml(root, "test");
+  auto again = make();
+  again->parse_xml(root, "test", false);
+  REQUIRE(again->length() == 3);
+  REQUIRE(again->get<int32_t>(1, "a") == -3);
+  REQUIRE(again->get<uint16_t>(0, "b") == 2);
+  REQUIRE(again->get_bytes() == arr->get_bytes());
+}
+
+TEST_CASE("LazyArray needs fixed size elements") {
+  REQUIRE_THROWS(LazyArray::create(2, []() { return CString8l::create(); }));
+}
+
+TEST_CASE("Array parses and builds fixed size elements in parallel") {
+  auto make = []() {
+    return Array::create(1000, []() {
+      return Struct::create(Field("id", Int32ul::create()),
+                            Field("value", Int16ub::create()));
+    });
+  };
+  std::vector<uint8_t> buffer;
+  for (uint32_t i = 0; i < 1000; i++) {
+    uint8_t record[6] = {uint8_t(i), uint8_t(i >> 8), 0, 0, uint8_t(i >> 8),
+                         uint8_t(i)};
+    buffer.insert(buffer.end(), record, record + 6);
+  }
+
+  ThreadPool pool(4);
+  pool.min_elements = 16;
+  auto arr = make();
+  {
+    ParallelScope scope(pool);
+    InputCursor cursor(std::as_bytes(std::span(buffer)));
+    arr->parse(cursor);
+    REQUIRE(cursor.tell() == buffer.size());
+    OutputCursor out;
+    out.write("x", 1);
+    arr->build(out);
+    auto built = out.buffer().subspan(1);
+    REQUIRE(std::vector<std::byte>(built.begin(), built.end()) ==
+            std::vector<std::byte>(std::as_bytes(std::span(buffer)).begin(),
+                                   std::as_bytes(std::span(buffer)).end()));
+    REQUIRE(lock(arr->get_field<Base>(2))->get_offset() == 13);
+  }
+  REQUIRE(arr->length() == 1000);
+  REQUIRE(arr->get_size() == buffer.size());
+  REQUIRE(arr->get<uint32_t>(999, "id") == 999);
+  REQUIRE(arr->get<uint16_t>(513, "value") == 513);
+  REQUIRE(arr->get_offset(7) == 43);
+
+  // the error names the first failing element, like a serial parse
+  buffer.resize(buffer.size() - 1);
+  ParallelScope scope(pool);
+  InputCursor cursor(std::as_bytes(std::span(buffer)));
+  auto parsed = make()->try_parse(cursor);
+  REQUIRE(!parsed);
+  REQUIRE(parsed.error().path_string() == "999->[id]");
+}
+
+TEST_CASE("Array builds resized elements serially") {
+  auto arr = Array::create(
+      64, []() { return NumberArray<Int16ul>::create(2); });
+  std::vector<uint16_t> data(128);
+  std::iota(data.begin(), data.end(), 0);
+  InputCursor cursor(std::as_bytes(std::span(data)));
+  arr->parse(cursor);
+
+  // element 3 no longer matches the stride of element 0
+  auto third = lock(arr->get_field<NumberArray<Int16ul>>(3));
+  third->set(std::vector<uint16_t>{100, 101, 102, 103});
+  data.erase(data.begin() + 6, data.begin() + 8);
+  data.insert(data.begin() + 6, {100, 101, 102, 103});
+
+  ThreadPool pool(4);
+  pool.min_elements = 16;
+  ParallelScope scope(pool);
+  OutputCursor out;
+  arr->build(out);
+  auto built = out.buffer();
+  REQUIRE(built.size() == 130 * sizeof(uint16_t));
+  REQUIRE(std::memcmp(built.data(), data.data(), built.size()) == 0);
+}
+
+TEST_CASE("Array builds Rebuild elements on the calling thread") {
+  auto caller = std::this_thread::get_id();
+  std::atomic<size_t> elsewhere = 0;
+  auto arr = Array::create(64, [&]() {
+    return Rebuild::create(
+        [&](std::weak_ptr<Base>) -> std::any {
+          if (std::this_thread::get_id() != caller) {
+            elsewhere++;
+          }
+          return uint32_t(7);
+        },
+        Int32ul::create());
+  });
+  std::vector<uint32_t> data(64, 1);
+  ThreadPool pool(4);
+  pool.min_elements = 8;
+  ParallelScope scope(pool);
+  InputCursor cursor(std::as_bytes(std::span(data)));
+  arr->parse(cursor);
+  REQUIRE(!lock(arr->get_field(0))->is_fixed_layout());
+  OutputCursor out;
+  arr->build(out);
+  REQUIRE(elsewhere == 0);
+  REQUIRE(out.size() == 256);
+}
+
+// keeps the output in memory and records the largest write
+class VectorSink : public OutputSink {
+public:
+  std::vector<char> data;
+  size_t largest = 0;
+
+  void write(size_t offset, std::span<const char> bytes) override {
+    data.resize(std::max(data.size(), offset + bytes.size()));
+    std::copy(bytes.begin(), bytes.end(), data.begin() + offset);
+    largest = std::max(largest, bytes.size());
+  }
+};
+
+TEST_CASE("Array builds in parallel through a small sink window") {
+  auto arr = Array::create(100, []() { return Int32ul::create(); });
+  std::vector<uint32_t> values(100);
+  std::iota(values.begin(), values.end(), 0);
+  InputCursor cursor(std::as_bytes(std::span(values)));
+  arr->parse(cursor);
+
+  ThreadPool pool(3);
+  pool.min_elements = 8;
+  ParallelScope scope(pool);
+  auto sink = std::make_shared<VectorSink>();
+  OutputCursor out(sink, 64);
+  arr->build(out);
+  out.flush();
+  REQUIRE(sink->largest <= 64);
+  REQUIRE(sink->data.size() == 400);
+  REQUIRE(std::memcmp(sink->data.data(), values.data(), 400) == 0);
+}
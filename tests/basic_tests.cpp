@@ -1,5 +1,7 @@
+#include "array.hpp"
 #include "basic.hpp"
 #include "number.hpp"
+#include "struct.hpp"
 #include <catch2/catch_test_macros.hpp>
 
 using namespace etcetera;
@@ -64,6 +66,17 @@ TEST_CASE("Const string XML empty") {
   REQUIRE(ss.str() == data.str());
 }
 
+TEST_CASE("Empty Const string and Bytes in a fixed run") {
+  auto s = Struct::create(Field("c", BytesConst::create("")),
+                          Field("b", Bytes::create(0)));
+  InputCursor cursor(std::span<const std::byte>{});
+  s->parse(cursor);
+  REQUIRE(s->get_size() == 0);
+  OutputCursor out;
+  s->build(out);
+  REQUIRE(out.size() == 0);
+}
+
 TEST_CASE("Bytes") {
   auto field = Bytes::create(6);
   std::stringstream data;
@@ -145,3 +158,70 @@ TEST_CASE("Enum XML") {
   e->build_xml(root, "test4");
   REQUIRE(std::string(root.attribute("test4").as_string()) == "4");
 }
+
+TEST_CASE("Expr") {
+  using namespace etcetera::expr;
+  REQUIRE(((Expr(3) + 4) * 2).constant() == 14);
+  REQUIRE((Expr(7) % 4 == 3).constant() == 1);
+  REQUIRE((-Expr(2) << 3).constant() == -16);
+  REQUIRE((this_["count"] * 2).constant() == std::nullopt);
+  REQUIRE((this_["count"] * parent["a"]["b"]).fields() ==
+          std::vector<std::vector<std::string>>{{"count"}, {"_", "a", "b"}});
+  REQUIRE_THROWS((Expr(1) / 0).constant());
+  REQUIRE_THROWS_AS(Expr(1) << 64, ParseFailure);
+  REQUIRE_THROWS_AS(Expr(1) >> -1, ParseFailure);
+  auto min = std::numeric_limits<int64_t>::min();
+  REQUIRE_THROWS_AS(Expr(min) / -1, ParseFailure);
+  REQUIRE_THROWS_AS(Expr(min) % -1, ParseFailure);
+  REQUIRE((Expr(1) << 63).constant() == min);
+  REQUIRE((-Expr(min)).constant() == min);
+
+  auto fixed = Bytes::create(Expr(2) * 3);
+  REQUIRE(fixed->fixed_size() == 6);
+  REQUIRE(constant_of(std::function<size_t(std::weak_ptr<Base>)>(
+              [](std::weak_ptr<Base>) { return 1; })) == std::nullopt);
+}
+
+TEST_CASE("Expr sizes") {
+  using namespace etcetera::expr;
+  auto s = Struct::create(
+      Field("count", Int16ul::create()),
+      Field("data", Bytes::create(this_["count"] * 2)),
+      Field("inner",
+            Struct::create(Field("values",
+                                 Array::create(parent["count"] - 1, []() {
+                                   return Int8ul::create();
+                                 })))));
+  std::stringstream data;
+  uint16_t count = 3;
+  data.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  data.write("abcdefgh", 8);
+  s->parse(data);
+
+  REQUIRE(s->get<std::vector<uint8_t>>("data") ==
+          std::vector<uint8_t>{'a', 'b', 'c', 'd', 'e', 'f'});
+  REQUIRE(s->get<uint8_t>("inner", "values", 1) == 'h');
+  REQUIRE(s->get_size() == 10);
+  REQUIRE(lock(s->get_field("data"))->dependencies() ==
+          std::vector<std::vector<std::string>>{{"count"}});
+
+  REQUIRE_THROWS(Struct::create(Field("data", Bytes::create(this_["count"])),
+                                Field("count", Int16ul::create())));
+}
+
+TEST_CASE("Expr reports undefined shifts while parsing") {
+  using namespace etcetera::expr;
+  auto s = Struct::create(
+      Field("count", Int8ul::create()),
+      Field("data", Bytes::create(Expr(1) << this_["count"])));
+  std::vector<char> data = {64};
+  InputCursor cursor(data);
+  std::string path;
+  try {
+    s->parse(cursor);
+  } catch (ParseFailure &e) {
+    path = e.error.path_string();
+    REQUIRE(e.error.reason == "Expr: shift by 64");
+  }
+  REQUIRE(path == "[data]");
+}
@@ -0,0 +1,88 @@
+#include "binding.hpp"
+#include "struct.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+using namespace etcetera;
+
+namespace {
+
+struct Vertex {
+  float x, y, z;
+  uint32_t color;
+};
+
+struct Entry {
+  uint8_t id;
+  std::string name;
+  std::array<uint16_t, 2> flags;
+};
+
+} // namespace
+
+using VertexBinding = Binding<Vertex, Bind<"x", &Vertex::x, Float32l>,
+                              Bind<"y", &Vertex::y, Float32l>,
+                              Bind<"z", &Vertex::z, Float32l>,
+                              Bind<"color", &Vertex::color, Int32ub>>;
+using EntryBinding =
+    Binding<Entry, Bind<"id", &Entry::id, Int8ul>,
+            Bind<"name", &Entry::name, CString8l>,
+            Bind<"flags", &Entry::flags, StaticArray<Int16ul, 2>>>;
+
+static_assert(VertexBinding::fixed);
+static_assert(VertexBinding::size == 16);
+static_assert(VertexBinding::offset<"color">() == 12);
+static_assert(!EntryBinding::fixed);
+
+TEST_CASE("Binding parses into structs") {
+  std::vector<Vertex> vertices(100);
+  for (size_t i = 0; i < vertices.size(); i++) {
+    vertices[i] = {float(i), float(i) * 2, float(i) * 3, uint32_t(i)};
+  }
+
+  OutputCursor out;
+  VertexBinding::build_all(out, vertices);
+  auto data = out.release();
+  REQUIRE(data.size() == vertices.size() * VertexBinding::size);
+  // color is big endian
+  REQUIRE(data[16 + 15] == 1);
+
+  InputCursor cursor(data);
+  auto parsed = VertexBinding::parse_all(cursor, vertices.size());
+  REQUIRE(cursor.eof());
+  REQUIRE(parsed[42].y == 84.0f);
+  REQUIRE(parsed[42].color == 42);
+  REQUIRE(VertexBinding::get<"z">(parsed[3]) == 9.0f);
+}
+
+TEST_CASE("Binding with dynamic fields") {
+  std::vector<char> data = {1, 'a', 0, 2, 0, 3, 0, 2, 'b', 'c', 0, 4, 0, 5, 0};
+  InputCursor cursor(data);
+  auto entries = EntryBinding::parse_all(cursor, 2);
+  REQUIRE(entries[0].name == "a");
+  REQUIRE(entries[0].flags[1] == 3);
+  REQUIRE(entries[1].id == 2);
+  REQUIRE(entries[1].name == "bc");
+  REQUIRE(entries[1].flags[0] == 4);
+
+  OutputCursor out;
+  EntryBinding::build_all(out, entries);
+  REQUIRE(out.release() == data);
+}
+
+TEST_CASE("Binding in a dynamic tree") {
+  auto s = Struct::create(Field("count", Int32ul::create()),
+                          Field("vertex", Static<VertexBinding>::create()));
+  std::vector<char> data = {1, 0, 0, 0};
+  OutputCursor out;
+  Vertex v = {1.0f, 2.0f, 3.0f, 0x11223344};
+  VertexBinding::build(out, v);
+  auto bytes = out.release();
+  data.insert(data.end(), bytes.begin(), bytes.end());
+
+  InputCursor cursor(data);
+  s->parse(cursor);
+  REQUIRE(s->get<uint32_t>("vertex", "color") == 0x11223344);
+  auto node = s->get_field<Static<VertexBinding>>("vertex").lock();
+  REQUIRE(node->value.z == 3.0f);
+  REQUIRE(s->get_bytes() == data);
+}
@@ -0,0 +1,70 @@
+#include "helpers.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+
+using namespace etcetera;
+
+template <typename T> static std::vector<T> make_values(size_t n) {
+  std::vector<T> ret(n);
+  for (size_t i = 0; i < n; i++) {
+    ret[i] = static_cast<T>(0x0102030405060708ull * (i + 1));
+  }
+  return ret;
+}
+
+template <typename T>
+static void check_kernel(byteswap::Kernel kernel, size_t n) {
+  auto values = make_values<T>(n);
+  auto expected = values;
+  for (auto &v : expected) {
+    v = std::byteswap(v);
+  }
+  kernel(values.data(), values.size());
+  REQUIRE(values == expected);
+}
+
+template <typename T> static void check_kernels(size_t n) {
+  check_kernel<T>(byteswap::scalar<sizeof(T)>, n);
+  check_kernel<T>(byteswap::select<sizeof(T)>(), n);
+  check_kernel<T>(byteswap_array<sizeof(T)>, n);
+#ifdef ETCETERA_BYTESWAP_X86
+  if (__builtin_cpu_supports("ssse3")) {
+    check_kernel<T>(byteswap::ssse3<sizeof(T)>, n);
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    check_kernel<T>(byteswap::avx2<sizeof(T)>, n);
+  }
+#endif
+}
+
+TEST_CASE("Byteswap kernels") {
+  // sizes around the vector widths, so the scalar tails are covered
+  for (size_t n : {0, 1, 3, 7, 8, 15, 16, 17, 33, 100, 1027}) {
+    check_kernels<uint16_t>(n);
+    check_kernels<uint32_t>(n);
+    check_kernels<uint64_t>(n);
+  }
+}
+
+TEST_CASE("Byteswap unaligned") {
+  std::vector<uint8_t> bytes(4 * 21 + 1);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = i;
+  }
+  byteswap_array<4>(bytes.data() + 1, 21);
+  REQUIRE(bytes[0] == 0);
+  for (size_t i = 0; i < 21; i++) {
+    REQUIRE(bytes[1 + i * 4] == 4 + i * 4);
+    REQUIRE(bytes[4 + i * 4] == 1 + i * 4);
+  }
+}
+
+TEST_CASE("swap_endian_n floats") {
+  std::vector<float> values = {1.5f, -2.25f, 1e10f, 0.0f, 3.0f};
+  auto swapped = values;
+  swap_endian_n<std::endian::big>(swapped.data(), swapped.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    REQUIRE(swapped[i] == swap_endian<std::endian::big>(values[i]));
+  }
+}
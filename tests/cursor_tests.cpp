@@ -0,0 +1,136 @@
+#include "array.hpp"
+#include "cursor.hpp"
+#include "number.hpp"
+#include "pointer.hpp"
+#include "struct.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <sstream>
+
+using namespace etcetera;
+
+TEST_CASE("InputCursor reads") {
+  std::array<uint8_t, 6> data = {0x12, 0x34, 0x56, 0x78, 0xAA, 0xBB};
+  InputCursor cursor(std::as_bytes(std::span(data)));
+  REQUIRE(cursor.read<uint32_t, std::endian::big>() == 0x12345678);
+  REQUIRE(cursor.tell() == 4);
+  REQUIRE(cursor.remaining() == 2);
+  REQUIRE(cursor.read<uint16_t, std::endian::little>() == 0xBBAA);
+  REQUIRE(cursor.eof());
+  REQUIRE_THROWS(cursor.read<uint8_t>());
+  REQUIRE_THROWS(cursor.seek(7));
+  cursor.seek(2);
+  REQUIRE(cursor.read(2).size() == 2);
+}
+
+TEST_CASE("Parse from InputCursor") {
+  auto s = Struct::create(
+      Field("a", Int32ul::create()), Field("b", Int16ub::create()),
+      Field("c", Array::create(2, []() { return Float32l::create(); })));
+  std::vector<char> data;
+  auto append = [&](auto v) {
+    auto p = reinterpret_cast<const char *>(&v);
+    data.insert(data.end(), p, p + sizeof(v));
+  };
+  append(uint32_t(0x12345678));
+  append(std::byteswap(uint16_t(0xABCD)));
+  append(1.5f);
+  append(-2.25f);
+
+  InputCursor cursor(data);
+  s->parse(cursor);
+  REQUIRE(cursor.tell() == data.size());
+  REQUIRE(s->get<uint32_t>("a") == 0x12345678);
+  REQUIRE(s->get<uint16_t>("b") == 0xABCD);
+  REQUIRE(s->get<float>("c", 0) == 1.5f);
+  REQUIRE(s->get<float>("c", 1) == -2.25f);
+}
+
+TEST_CASE("Parse past end throws") {
+  auto s = Struct::create(Field("a", Int32ul::create()),
+                          Field("b", Int32ul::create()));
+  std::vector<char> data(6, 0);
+  InputCursor cursor(data);
+  REQUIRE_THROWS(s->parse(cursor));
+}
+
+TEST_CASE("OutputCursor writes") {
+  OutputCursor cursor;
+  cursor.write<uint32_t, std::endian::big>(0x12345678);
+  REQUIRE(cursor.tell() == 4);
+  cursor.seek(8);
+  REQUIRE(cursor.size() == 4);
+  cursor.write<uint16_t, std::endian::little>(0xBBAA);
+  REQUIRE(cursor.size() == 10);
+  cursor.seek(2);
+  cursor.skip(10);
+  REQUIRE(cursor.size() == 12);
+
+  std::vector<char> expected = {0x12, 0x34, 0x56, 0x78, 0, 0,
+                                0,    0,    char(0xAA), char(0xBB), 0, 0};
+  REQUIRE(cursor.release() == expected);
+  REQUIRE(cursor.size() == 0);
+}
+
+TEST_CASE("Cursors take empty reads and writes") {
+  OutputCursor out;
+  out.write(nullptr, 0);
+  out.write_array<uint32_t, std::endian::big>(nullptr, 0);
+  REQUIRE(out.tell() == 0);
+  REQUIRE(out.size() == 0);
+
+  InputCursor in(std::span<const std::byte>{});
+  in.read(nullptr, 0);
+  REQUIRE(in.tell() == 0);
+}
+
+TEST_CASE("Build into a std::ostream at its position") {
+  std::stringstream ss;
+  ss.write("abcd", 4);
+  Array::create(0, []() { return Int8ul::create(); })->build(ss);
+  REQUIRE(ss.tellp() == 4);
+  REQUIRE(ss.str() == "abcd");
+
+  auto s = Struct::create(
+      Field("a", Int8ul::create()),
+      Field("b", Pointer::create([](std::weak_ptr<Base>) { return 8; },
+                                 Int8ul::create())));
+  lock(s->get_field("a"))->set(uint8_t('x'));
+  lock(s->get_field("b"))->set(uint8_t('y'));
+  ss.seekp(2);
+  s->build(ss);
+  REQUIRE(ss.tellp() == 3);
+  REQUIRE(ss.str() == std::string("abxd\0\0\0\0y", 9));
+}
+
+TEST_CASE("Build Area into OutputCursor") {
+  auto s = Struct::create(
+      Field("off", Int32ul::create()), Field("size", Int32ul::create()),
+      Field("b", Area::create(
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("off");
+                     },
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("size");
+                     },
+                     []() { return Int32ul::create(); })));
+  std::vector<char> data;
+  auto append = [&](auto v) {
+    auto p = reinterpret_cast<const char *>(&v);
+    data.insert(data.end(), p, p + sizeof(v));
+  };
+  append(uint32_t(12));
+  append(uint32_t(8));
+  append(uint32_t(0));
+  append(uint32_t(456));
+  append(uint32_t(789));
+
+  InputCursor input(data);
+  s->parse(input);
+
+  OutputCursor output;
+  s->build(output);
+  REQUIRE(output.tell() == 8);
+  REQUIRE(output.release() == data);
+}
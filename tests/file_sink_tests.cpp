@@ -0,0 +1,77 @@
+#include "file_sink.hpp"
+#include "helpers.hpp"
+#include "number.hpp"
+#include "pointer.hpp"
+#include "special.hpp"
+#include "struct.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using namespace etcetera;
+
+static std::vector<char> read_file(const std::filesystem::path &path) {
+  std::ifstream f(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(f), {});
+}
+
+TEST_CASE("FileSink out of order writes") {
+  auto path = std::filesystem::temp_directory_path() / "etcetera_sink.bin";
+  auto sink = FileSink::open(path.string());
+  // a window smaller than the output forces several flushes
+  auto cursor = sink->cursor(6);
+  cursor.write<uint32_t, std::endian::big>(0x01020304);
+  cursor.seek(12);
+  cursor.write<uint32_t, std::endian::big>(0x0D0E0F10);
+  cursor.seek(4);
+  cursor.write<uint32_t, std::endian::big>(0x05060708);
+  cursor.write<uint16_t, std::endian::big>(0x090A);
+  cursor.seek(1);
+  cursor.write<uint8_t>(0xFF);
+  cursor.seek(16);
+  cursor.skip(4);
+  cursor.flush();
+
+  std::vector<char> expected = {1, char(0xFF), 3, 4, 5, 6, 7, 8, 9, 10, 0,
+                                0, 13, 14, 15, 16, 0, 0, 0, 0};
+  REQUIRE(read_file(path) == expected);
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("FileSink build with Pointer and Aligned") {
+  auto s = Struct::create(
+      Field("off", Int32ul::create()),
+      Field("p", Pointer::create(
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("off");
+                     },
+                     Int64ul::create())),
+      Field("aligned", Aligned::create(8, Int16ul::create())),
+      Field("back", Int32ul::create()));
+  std::vector<char> data;
+  auto append = [&](auto v) {
+    auto p = reinterpret_cast<const char *>(&v);
+    data.insert(data.end(), p, p + sizeof(v));
+  };
+  append(uint32_t(16));
+  append(uint16_t(0x1234));
+  append(uint16_t(0));
+  append(uint32_t(0));
+  append(uint32_t(0xAABBCCDD));
+  append(uint64_t(0x0102030405060708));
+
+  InputCursor input(data);
+  s->parse(input);
+
+  auto path = std::filesystem::temp_directory_path() / "etcetera_build.bin";
+  auto sink = FileSink::open(path.string());
+  auto cursor = sink->cursor(4);
+  s->build(cursor);
+  cursor.flush();
+  REQUIRE(read_file(path) == data);
+
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,106 @@
+#include "layout.hpp"
+#include "number.hpp"
+#include "pointer.hpp"
+#include "string.hpp"
+#include "struct.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+
+using namespace etcetera;
+using namespace etcetera::expr;
+
+static std::shared_ptr<Struct> make_archive() {
+  return Struct::create(
+      Field("offset", Int32ul::create()), Field("size", Int32ul::create()),
+      Field("data", Area::create(this_["offset"], this_["size"],
+                                 []() { return Int16ul::create(); })),
+      Field("name_offset", Int32ul::create()),
+      Field("name", Pointer::create(this_["name_offset"] + 1,
+                                    CString8l::create())));
+}
+
+static std::vector<uint8_t> bytes_of(std::span<const std::byte> bytes) {
+  auto chars = reinterpret_cast<const uint8_t *>(bytes.data());
+  return std::vector<uint8_t>(chars, chars + bytes.size());
+}
+
+TEST_CASE("Layout places payloads behind the tree") {
+  std::vector<uint8_t> input = {20, 0, 0, 0, 4, 0, 0, 0, 27, 0, 0, 0,
+                                0,  0, 0, 0, 0, 0, 0, 0, 1, 0, 2, 0,
+                                0,  0, 0, 0, 'h', 'i', 0};
+  auto root = make_archive();
+  InputCursor in(std::as_bytes(std::span(input)));
+  root->parse(in);
+  REQUIRE(root->get<std::string>("name") == "hi");
+
+  Layout layout;
+  layout.alignment = 4;
+  OutputCursor out;
+  layout.build(*root, out);
+  REQUIRE(root->get<uint32_t>("offset") == 12);
+  REQUIRE(root->get<uint32_t>("size") == 4);
+  REQUIRE(root->get<uint32_t>("name_offset") == 15);
+  REQUIRE(bytes_of(out.buffer()) ==
+          std::vector<uint8_t>{12, 0, 0, 0, 4, 0, 0, 0, 15, 0, 0, 0, 1, 0, 2,
+                               0, 'h', 'i', 0});
+  REQUIRE(out.tell() == 19);
+
+  // the payloads are built inline again afterwards
+  OutputCursor again;
+  root->build(again);
+  REQUIRE(bytes_of(again.buffer()) == bytes_of(out.buffer()));
+
+  auto reparsed = make_archive();
+  InputCursor in2(out.buffer());
+  reparsed->parse(in2);
+  REQUIRE(reparsed->get<std::string>("name") == "hi");
+  REQUIRE(reparsed->get<uint16_t>("data", 1) == 2);
+}
+
+TEST_CASE("Layout writes sequentially") {
+  struct Recorder : OutputSink {
+    std::vector<std::pair<size_t, size_t>> writes;
+    void write(size_t offset, std::span<const char> bytes) override {
+      writes.emplace_back(offset, bytes.size());
+    }
+  };
+  std::vector<uint8_t> input = {28, 0, 0, 0, 2, 0, 0, 0, 12, 0, 0, 0,
+                                'a', 'b', 'c', 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                0, 0, 0, 0, 7, 0};
+  auto root = make_archive();
+  InputCursor in(std::as_bytes(std::span(input)));
+  root->parse(in);
+
+  Layout layout;
+  size_t placed = 0;
+  layout.place = [&](Base &, size_t size, size_t end) {
+    placed += size;
+    return end + 8;
+  };
+  auto sink = std::make_shared<Recorder>();
+  OutputCursor out(sink, 4);
+  layout.build(*root, out);
+  out.flush();
+  REQUIRE(placed == 5);
+  REQUIRE(root->get<uint32_t>("offset") == 20);
+  REQUIRE(root->get<uint32_t>("name_offset") == 29);
+  size_t end = 0;
+  for (auto &[offset, size] : sink->writes) {
+    REQUIRE(offset >= end);
+    end = offset + size;
+  }
+  REQUIRE(end == 33);
+}
+
+TEST_CASE("Layout needs expressions") {
+  auto root = Struct::create(
+      Field("offset", Int32ul::create()),
+      Field("data", Pointer::create(
+                        [](std::weak_ptr<Base> c) {
+                          return lock(c)->get<uint32_t>("offset");
+                        },
+                        Int32ul::create())));
+  Layout layout;
+  REQUIRE_THROWS(layout.apply(*root));
+}
@@ -0,0 +1,57 @@
+#include "helpers.hpp"
+#include "mapped_file.hpp"
+#include "number.hpp"
+#include "pointer.hpp"
+#include "struct.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+using namespace etcetera;
+
+TEST_CASE("MappedFile parse with Pointer and Area") {
+  auto s = Struct::create(
+      Field("off", Int32ul::create()), Field("size", Int32ul::create()),
+      Field("p", Pointer::create(
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("off");
+                     },
+                     Int32ul::create())),
+      Field("b", Area::create(
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("off");
+                     },
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("size");
+                     },
+                     []() { return Int32ul::create(); })));
+  uint32_t off = 12;
+  uint32_t size = 12;
+  uint32_t pad = 0;
+  uint32_t data[3] = {456, 789, 123};
+
+  auto path = std::filesystem::temp_directory_path() / "etcetera_mapped.bin";
+  {
+    std::ofstream f(path, std::ios::binary);
+    f.write(reinterpret_cast<const char *>(&off), sizeof(off));
+    f.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    f.write(reinterpret_cast<const char *>(&pad), sizeof(pad));
+    f.write(reinterpret_cast<const char *>(&data), sizeof(data));
+  }
+
+  auto file = MappedFile::open(path.string());
+  REQUIRE(file->size() == 24);
+  auto cursor = file->cursor();
+  s->parse(cursor);
+  REQUIRE(cursor.tell() == 8);
+  REQUIRE(s->get<uint32_t>("p") == 456);
+  REQUIRE(s->get<uint32_t>("b", 2) == 123);
+  REQUIRE(lock(s->get_field<Area>("b"))->get_ptr_size({}) == size);
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("MappedFile missing file") {
+  REQUIRE_THROWS(MappedFile::open("/nonexistent/etcetera.bin"));
+}
@@ -1,6 +1,7 @@
 #include "array.hpp"
 #include "basic.hpp"
 #include "number.hpp"
+#include "string.hpp"
 #include "struct.hpp"
 #include <catch2/catch_test_macros.hpp>
 
@@ -62,3 +63,54 @@ TEST_CASE("Offset Tests Nested Array") {
   REQUIRE(a->get_offset(2, 0) == 16);
   REQUIRE(a->get_offset(2, 1) == 20);
 }
+
+TEST_CASE("Offset Tests recorded by parse") {
+  auto s = Struct::create(
+      Field("a", Int32ul::create()),
+      Field("b", Array::create(2, []() { return Int16ul::create(); })),
+      Field("c", Int32ul::create()));
+
+  std::vector<char> data(12, 0);
+  InputCursor cursor(data);
+  s->parse(cursor);
+
+  REQUIRE(lock(s->get_field("c"))->has_offset());
+  REQUIRE(s->get_offset("c") == 8);
+  REQUIRE(s->get_offset("b", 1) == 6);
+  REQUIRE(lock(s->get_field<Array>("b"))->get_field(1).lock()->get_offset() ==
+          6);
+
+  // growing the array moves everything behind it
+  lock(s->get_field<Array>("b"))->set(std::vector<std::any>(
+      {std::any(uint16_t(1)), std::any(uint16_t(2)), std::any(uint16_t(3))}));
+  REQUIRE(!lock(s->get_field("c"))->has_offset());
+  REQUIRE(lock(s->get_field("a"))->has_offset());
+  REQUIRE(s->get_offset("c") == 10);
+  REQUIRE(s->get_offset("b", 2) == 8);
+}
+
+TEST_CASE("Offset Tests after assigning a string directly") {
+  auto s = Struct::create(
+      Field("a", CString8l::create()), Field("b", Int32ul::create()),
+      Field("c", Struct::create(Field("d", Int16ul::create()))));
+  std::vector<char> data = {'a', 'b', 'c', 0, 1, 0, 0, 0, 2, 0};
+  InputCursor cursor(data);
+  s->parse(cursor);
+  REQUIRE(s->get_offset("b") == 4);
+
+  lock(s->get_field<CString8l>("a"))->value = "abcdefgh";
+  REQUIRE(s->get_offset("b") == 9);
+  REQUIRE(s->get_offset("c", "d") == 13);
+  REQUIRE(lock(s->get_field("c"))->get_offset() == 13);
+}
+
+TEST_CASE("Offset Tests recorded offsets are trusted after parse") {
+  auto a = Array::create(
+      3, []() { return Array::create(2, []() { return Int32ul::create(); }); });
+  std::vector<int32_t> data = {0, 1, 2, 3, 4, 5};
+  InputCursor cursor(std::as_bytes(std::span(data)));
+  a->parse(cursor);
+  REQUIRE(a->size_memoized());
+  REQUIRE(lock(a->get_field(2))->get_field(1).lock()->offset_current());
+  REQUIRE(a->get_offset(2, 1) == 20);
+}
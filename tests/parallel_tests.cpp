@@ -0,0 +1,42 @@
+#include "parallel.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+#include <numeric>
+#include <stdexcept>
+
+using namespace etcetera;
+
+TEST_CASE("ThreadPool runs every index once") {
+  ThreadPool pool(4);
+  std::vector<std::atomic<int>> hits(10007);
+  pool.parallel_for(hits.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      hits[i]++;
+    }
+  });
+  for (auto &hit : hits) {
+    REQUIRE(hit == 1);
+  }
+  pool.parallel_for(0, [](size_t, size_t) {});
+}
+
+TEST_CASE("ThreadPool rethrows errors") {
+  ThreadPool pool(2);
+  REQUIRE_THROWS_AS(pool.parallel_for(100,
+                                      [](size_t begin, size_t end) {
+                                        if (begin <= 50 && 50 < end) {
+                                          throw std::runtime_error("50");
+                                        }
+                                      }),
+                    std::runtime_error);
+}
+
+TEST_CASE("ParallelScope sets the pool of this thread") {
+  ThreadPool pool(1);
+  REQUIRE(current_pool == nullptr);
+  {
+    ParallelScope scope(pool);
+    REQUIRE(current_pool == &pool);
+  }
+  REQUIRE(current_pool == nullptr);
+}
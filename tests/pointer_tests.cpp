@@ -2,6 +2,7 @@
 #include "helpers.hpp"
 #include "number.hpp"
 #include "pointer.hpp"
+#include "schedule.hpp"
 #include "struct.hpp"
 #include <catch2/catch_test_macros.hpp>
 
@@ -125,3 +126,202 @@ TEST_CASE("Area build test") {
   orig.seekg(0, std::ios::beg);
   REQUIRE(ss.str() == orig.str());
 }
+
+TEST_CASE("Area parses and builds fixed size elements in parallel") {
+  auto s = Struct::create(
+      Field("off", Int32ul::create()), Field("size", Int32ul::create()),
+      Field("b", Area::create(
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("off");
+                     },
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("size");
+                     },
+                     []() { return Int32ul::create(); })));
+  std::vector<uint32_t> data = {8, 256};
+  for (uint32_t i = 0; i < 64; i++) {
+    data.push_back(i * 3);
+  }
+  // padding, so the area does not end the buffer
+  data.push_back(0);
+
+  ThreadPool pool(3);
+  pool.min_elements = 8;
+  ParallelScope scope(pool);
+  InputCursor cursor(std::as_bytes(std::span(data)), 0);
+  s->parse(cursor);
+  REQUIRE(cursor.tell() == 8);
+  auto area = lock(s->get_field<Area>("b"));
+  REQUIRE(area->length() == 64);
+  REQUIRE(area->get<uint32_t>(63) == 189);
+  REQUIRE(area->get_ptr_size({}) == 256);
+
+  OutputCursor out;
+  s->build(out);
+  auto built = out.buffer();
+  REQUIRE(built.size() == 264);
+  REQUIRE(std::memcmp(built.data(), data.data(), built.size()) == 0);
+}
+
+TEST_CASE("Lazy Pointer parses on first access") {
+  auto s = Struct::create(
+      Field("a", Int32ul::create()),
+      Field("b", Pointer::create_lazy(
+                     [](std::weak_ptr<Base> c) {
+                       return lock(c)->get<uint32_t>("a");
+                     },
+                     Int32ul::create())),
+      Field("c", Pointer::create_lazy(
+                     [](std::weak_ptr<Base>) { return 10; },
+                     Int32ul::create())));
+  std::vector<uint32_t> data = {8, 0, 123};
+  InputCursor cursor(std::as_bytes(std::span(data)));
+  s->parse(cursor);
+  REQUIRE(cursor.tell() == 4);
+
+  auto b = lock(s->get_field<Pointer>("b"));
+  auto c = lock(s->get_field<Pointer>("c"));
+  REQUIRE(!b->is_loaded());
+  REQUIRE(s->get<uint32_t>("b") == 123);
+  REQUIRE(b->is_loaded());
+  REQUIRE(b->target().get_offset() == 8);
+
+  // the field does not fit, which is only noticed when it is read
+  REQUIRE(!c->is_loaded());
+  std::string path;
+  try {
+    c->get();
+  } catch (ParseFailure &e) {
+    path = e.error.path_string();
+  }
+  REQUIRE(path == "[c]");
+  REQUIRE(!c->is_loaded());
+}
+
+// records the access hints instead of acting on them
+class HintSource : public BufferSource {
+public:
+  using BufferSource::BufferSource;
+  std::vector<std::tuple<size_t, size_t, bool>> hints;
+
+  void will_need(size_t offset, size_t size, bool sequential) override {
+    hints.push_back({offset, size, sequential});
+  }
+};
+
+TEST_CASE("Pointer parses its target without an access hint") {
+  auto s = Struct::create(
+      Field("p", Pointer::create([](std::weak_ptr<Base>) { return 4; },
+                                 Int32ul::create())));
+  std::vector<uint32_t> words = {0, 7};
+  auto bytes = std::as_bytes(std::span(words));
+  auto source = std::make_shared<HintSource>(
+      std::vector<std::byte>(bytes.begin(), bytes.end()));
+  InputCursor cursor(source);
+  s->parse(cursor);
+  REQUIRE(s->get<uint32_t>("p") == 7);
+  REQUIRE(source->hints.empty());
+}
+
+TEST_CASE("Area hints its whole payload before parsing it") {
+  auto s = Struct::create(Field(
+      "b", Area::create([](std::weak_ptr<Base>) { return 4; },
+                        [](std::weak_ptr<Base>) { return 8; },
+                        []() { return Int32ul::create(); })));
+  std::vector<uint32_t> words = {0, 7, 9};
+  auto bytes = std::as_bytes(std::span(words));
+  auto source = std::make_shared<HintSource>(
+      std::vector<std::byte>(bytes.begin(), bytes.end()));
+  InputCursor cursor(source);
+  s->parse(cursor);
+  REQUIRE(s->get<uint32_t>("b", 1) == 9);
+  typedef std::tuple<size_t, size_t, bool> Hint;
+  REQUIRE(source->hints == std::vector<Hint>{{4, 8, true}});
+}
+
+TEST_CASE("ReadScheduler parses targets in offset order") {
+  auto make = []() {
+    auto inner = Struct::create(
+        Field("x", Int32ul::create()),
+        Field("d", Pointer::create([](std::weak_ptr<Base>) { return 40; },
+                                   Int32ul::create())));
+    return Struct::create(
+        Field("a", Int32ul::create()), Field("o", Int32ul::create()),
+        Field("n", Int32ul::create()),
+        Field("p", Pointer::create(
+                       [](std::weak_ptr<Base> c) {
+                         return lock(c)->get<uint32_t>("a");
+                       },
+                       Int32ul::create())),
+        Field("b", Area::create(
+                       [](std::weak_ptr<Base> c) {
+                         return lock(c)->get<uint32_t>("o");
+                       },
+                       [](std::weak_ptr<Base> c) {
+                         return lock(c)->get<uint32_t>("n");
+                       },
+                       []() { return Int32ul::create(); })),
+        Field("c", Pointer::create([](std::weak_ptr<Base>) { return 28; },
+                                   inner)));
+  };
+  std::vector<uint32_t> words = {24, 12, 8, 5, 6, 0, 7, 9, 0, 0, 11};
+  auto bytes = std::as_bytes(std::span(words));
+  auto source = std::make_shared<HintSource>(
+      std::vector<std::byte>(bytes.begin(), bytes.end()));
+
+  auto s = make();
+  ReadScheduler scheduler;
+  scheduler.max_gap = 0;
+  InputCursor cursor(source);
+  scheduler.parse(*s, cursor);
+  REQUIRE(cursor.tell() == 12);
+  REQUIRE(current_scheduler == nullptr);
+  REQUIRE(s->get<uint32_t>("p") == 7);
+  auto area = lock(s->get_field<Area>("b"));
+  REQUIRE(area->length() == 2);
+  REQUIRE(area->get<uint32_t>(1) == 6);
+  auto c = lock(s->get_field<Pointer>("c"));
+  REQUIRE(c->is_loaded());
+  REQUIRE(c->target().get<uint32_t>("x") == 9);
+  REQUIRE(c->target().get<uint32_t>("d") == 11);
+
+  // the area, the two adjacent pointers, then the nested pointer
+  typedef std::tuple<size_t, size_t, bool> Hint;
+  REQUIRE(source->hints == std::vector<Hint>{
+                               {12, 8, true}, {24, 4, true}, {40, 4, true}});
+  REQUIRE(scheduler.ranges == 3);
+
+  // close targets are read at once
+  source->hints.clear();
+  s = make();
+  ReadScheduler coalescing;
+  InputCursor again(source);
+  coalescing.parse(*s, again);
+  REQUIRE(source->hints ==
+          std::vector<Hint>{{12, 16, true}, {40, 4, true}});
+  REQUIRE(s->get<uint32_t>("p") == 7);
+
+  OutputCursor out;
+  s->build(out);
+  auto built = out.buffer();
+  REQUIRE(built.size() == bytes.size());
+  REQUIRE(std::memcmp(built.data(), bytes.data(), built.size()) == 0);
+}
+
+TEST_CASE("ReadScheduler reports failing targets") {
+  auto s = Struct::create(
+      Field("a", Int32ul::create()),
+      Field("p", Pointer::create([](std::weak_ptr<Base>) { return 6; },
+                                 Int32ul::create())));
+  std::vector<uint32_t> data = {1, 2};
+  InputCursor cursor(std::as_bytes(std::span(data)));
+  ReadScheduler scheduler;
+  std::string path;
+  try {
+    scheduler.parse(*s, cursor);
+  } catch (ParseFailure &e) {
+    path = e.error.path_string();
+  }
+  REQUIRE(path == "[p]");
+  REQUIRE(current_scheduler == nullptr);
+}
@@ -0,0 +1,195 @@
+#include "array.hpp"
+#include "number.hpp"
+#include "pointer.hpp"
+#include "schema.hpp"
+#include "special.hpp"
+#include "string.hpp"
+#include "struct.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+#include <thread>
+
+using namespace etcetera;
+
+static Schema make_schema() {
+  return Schema(Struct::create(
+      Field("count", Int32ul::create()),
+      Field("name", CString8l::create()),
+      Field("values", Array::create(
+                          [](std::weak_ptr<Base> c) {
+                            return lock(c)->get<uint32_t>("count");
+                          },
+                          []() { return Int16ul::create(); })),
+      Field("p", Pointer::create([](std::weak_ptr<Base>) { return 0; },
+                                 Int8ul::create()))));
+}
+
+static std::vector<char> make_data(uint32_t count, const std::string &name) {
+  std::vector<char> data;
+  auto p = reinterpret_cast<const char *>(&count);
+  data.insert(data.end(), p, p + sizeof(count));
+  data.insert(data.end(), name.begin(), name.end());
+  data.push_back('\0');
+  for (uint16_t i = 0; i < count; i++) {
+    auto v = reinterpret_cast<const char *>(&i);
+    data.insert(data.end(), v, v + sizeof(i));
+  }
+  return data;
+}
+
+TEST_CASE("Schema parses into separate instances") {
+  auto schema = make_schema();
+  auto data1 = make_data(2, "first");
+  auto data2 = make_data(5, "second");
+
+  InputCursor cursor1(data1);
+  auto a = schema.parse(cursor1);
+  InputCursor cursor2(data2);
+  auto b = schema.parse(cursor2);
+
+  REQUIRE(a != b);
+  REQUIRE(a->get<std::string>("name") == "first");
+  REQUIRE(b->get<std::string>("name") == "second");
+  REQUIRE(lock(a->get_field("values"))->length() == 2);
+  REQUIRE(b->get<uint16_t>("values", 4) == 4);
+  REQUIRE(a->get<uint8_t>("p") == 2);
+  REQUIRE(a->get_size() == data1.size());
+  REQUIRE(b->get_size() == data2.size());
+}
+
+TEST_CASE("Schema parses concurrently") {
+  auto schema = make_schema();
+  std::vector<std::thread> threads;
+  std::vector<size_t> lengths(8);
+  for (size_t i = 0; i < lengths.size(); i++) {
+    threads.emplace_back([&, i]() {
+      auto data = make_data(i * 100, "thread");
+      InputCursor cursor(data);
+      auto s = schema.parse(cursor);
+      lengths[i] = lock(s->get_field("values"))->length();
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (size_t i = 0; i < lengths.size(); i++) {
+    REQUIRE(lengths[i] == i * 100);
+  }
+}
+
+TEST_CASE("parse_tree keeps the values only in the tree") {
+  auto schema = make_schema();
+  auto data = make_data(3, "tree");
+  InputCursor cursor(data);
+  auto s = schema.instantiate();
+
+  s->parse_tree(cursor);
+
+  REQUIRE(cursor.tell() == data.size());
+  REQUIRE(s->get<std::string>("name") == "tree");
+  REQUIRE(s->get<uint16_t>("values", 2) == 2);
+  REQUIRE(collect_results);
+
+  InputCursor again(data);
+  auto parsed = std::any_cast<tsl::ordered_map<std::string, std::any>>(
+      s->parse(again));
+  REQUIRE(std::any_cast<std::string>(parsed["name"]) == "tree");
+}
+
+TEST_CASE("get_as reads values without std::any") {
+  auto schema = make_schema();
+  auto data = make_data(4, "typed");
+  InputCursor cursor(data);
+  auto s = schema.parse(cursor);
+
+  REQUIRE(s->get_as<uint32_t>("count") == 4);
+  REQUIRE(s->get_as<std::string>("name") == "typed");
+  REQUIRE(s->get_as<uint16_t>("values", 3) == 3);
+  REQUIRE(s->get_as<uint8_t>("p") == 4);
+
+  auto view = lock(s->get_field("name"))->value_view();
+  REQUIRE(*std::get<const std::string *>(view) == "typed");
+  REQUIRE(std::holds_alternative<std::monostate>(s->value_view()));
+}
+
+TEST_CASE("Schema try_parse reports where parsing failed") {
+  auto schema = make_schema();
+  auto data = make_data(4, "short");
+  data.resize(data.size() - 3);
+  InputCursor cursor(data);
+
+  auto ret = schema.try_parse(cursor);
+  REQUIRE(!ret);
+  auto &error = ret.error();
+  REQUIRE(error.path.size() == 2);
+  REQUIRE(std::get<size_t>(error.path[0]) == 2);
+  REQUIRE(std::get<std::string>(error.path[1]) == "values");
+  REQUIRE(error.offset == 14);
+  REQUIRE(error.path_string() == "[values]->2");
+  REQUIRE(error.message() ==
+          "[values]->2 @14: InputCursor: read past the end");
+
+  auto valid = make_data(1, "ok");
+  InputCursor valid_cursor(valid);
+  auto parsed = schema.try_parse(valid_cursor);
+  REQUIRE(parsed);
+  REQUIRE(parsed.value()->get<std::string>("name") == "ok");
+}
+
+TEST_CASE("parse throws ParseFailure with the path") {
+  auto s = make_schema().instantiate();
+  auto data = make_data(4, "short");
+  data.resize(data.size() - 3);
+  InputCursor cursor(data);
+
+  std::string message;
+  try {
+    s->parse(cursor);
+  } catch (ParseFailure &e) {
+    message = e.what();
+  }
+  REQUIRE(message == "[values]->2 @14: InputCursor: read past the end");
+  InputCursor again(data);
+  REQUIRE(!s->try_parse(again));
+}
+
+TEST_CASE("ParseFailure is a std::runtime_error") {
+  auto s = Struct::create(Field("a", Int32ul::create()),
+                          Field("b", Int32ul::create()));
+  std::vector<char> data(6, 0);
+  InputCursor cursor(data);
+
+  std::string path;
+  try {
+    s->parse(cursor);
+  } catch (std::runtime_error &e) {
+    auto failure = dynamic_cast<ParseFailure *>(&e);
+    REQUIRE(failure);
+    path = failure->error.path_string();
+  }
+  // the fixed run of a and b is read at once
+  REQUIRE(path == "[a]");
+}
+
+TEST_CASE("build throws BuildFailure with the path") {
+  auto s = Struct::create(
+      Field("a", Int32ul::create()),
+      Field("b", Array::create(2, []() {
+              return Rebuild::create(
+                  [](std::weak_ptr<Base>) -> std::any {
+                    throw std::runtime_error("no value");
+                  },
+                  Int32ul::create());
+            })));
+  std::vector<uint32_t> data = {1, 1, 0};
+  InputCursor cursor(std::as_bytes(std::span(data)));
+  s->parse(cursor);
+
+  std::string message;
+  try {
+    s->get_bytes();
+  } catch (BuildFailure &e) {
+    message = e.what();
+  }
+  REQUIRE(message == "[b]->0 @4: no value");
+}
@@ -0,0 +1,160 @@
+#include "conditional.hpp"
+#include "number.hpp"
+#include "static.hpp"
+#include "struct.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+using namespace etcetera;
+
+using Vec3 = StaticStruct<StaticField<"x", Float32l>,
+                          StaticField<"y", Float32l>,
+                          StaticField<"z", Float32l>>;
+using Header =
+    StaticStruct<StaticField<"magic", Int32ul>, StaticField<"count", Int16ub>,
+                 StaticField<"pos", Vec3>,
+                 StaticField<"ids", StaticArray<Int16ul, 3>>>;
+using Named = StaticStruct<StaticField<"id", Int8ul>,
+                           StaticField<"name", CString8l>,
+                           StaticField<"value", Int32ul>>;
+
+static_assert(Header::fixed);
+static_assert(Header::size == 4 + 2 + 12 + 6);
+static_assert(Header::offset<"pos">() == 6);
+static_assert(Header::offset<"ids">() == 18);
+static_assert(!Named::fixed);
+static_assert(Named::offset<"name">() == 1);
+
+TEST_CASE("StaticStruct parse and build") {
+  std::vector<char> data(Header::size);
+  uint32_t magic = 0x12345678;
+  uint16_t count = 0x0102;
+  float pos[3] = {1.0f, 2.0f, 3.0f};
+  uint16_t ids[3] = {7, 8, 9};
+  std::memcpy(data.data(), &magic, 4);
+  data[4] = 0x01;
+  data[5] = 0x02;
+  std::memcpy(data.data() + 6, pos, 12);
+  std::memcpy(data.data() + 18, ids, 6);
+
+  Header::value_type h;
+  InputCursor cursor(data);
+  Header::parse(cursor, h);
+  REQUIRE(cursor.tell() == Header::size);
+  REQUIRE(Header::get<"magic">(h) == magic);
+  REQUIRE(Header::get<"count">(h) == count);
+  REQUIRE(Vec3::get<"y">(Header::get<"pos">(h)) == 2.0f);
+  REQUIRE(Header::get<"ids">(h)[2] == 9);
+
+  OutputCursor out;
+  Header::build(out, h);
+  auto built = out.release();
+  REQUIRE(built == data);
+}
+
+TEST_CASE("StaticStruct with dynamic fields") {
+  std::vector<char> data = {5, 'a', 'b', 'c', 0, 0x78, 0x56, 0x34, 0x12};
+  Named::value_type n;
+  InputCursor cursor(data);
+  Named::parse(cursor, n);
+  REQUIRE(Named::get<"id">(n) == 5);
+  REQUIRE(Named::get<"name">(n) == "abc");
+  REQUIRE(Named::get<"value">(n) == 0x12345678);
+  REQUIRE(Named::size_of(n) == data.size());
+
+  OutputCursor out;
+  Named::build(out, n);
+  REQUIRE(out.release() == data);
+}
+
+using Record = StaticStruct<
+    StaticField<"magic", StaticConst<uint16_t(0x4241)>>,
+    StaticField<"tag", StaticBytesConst<"CD">>,
+    StaticField<"pad", StaticPadding<2>>, StaticField<"raw", StaticBytes<3>>,
+    StaticField<"name", StaticPaddedString<4>>,
+    StaticField<"wide",
+                StaticPaddedString<4, std::u16string, std::endian::big>>>;
+
+static_assert(Record::fixed);
+static_assert(Record::size == 2 + 2 + 2 + 3 + 4 + 4);
+static_assert(Record::offset<"wide">() == 13);
+
+TEST_CASE("StaticStruct with fixed size primitives") {
+  std::vector<char> data = {'A', 'B', 'C', 'D', 0, 0,   1,   2, 3,
+                            'x', 'y', 0,   0,   0, 'h', 0, 'i'};
+  Record::value_type r;
+  InputCursor cursor(data);
+  Record::parse(cursor, r);
+  REQUIRE(Record::get<"magic">(r) == 0x4241);
+  REQUIRE(Record::get<"tag">(r) == "CD");
+  REQUIRE(Record::get<"raw">(r) == std::array<uint8_t, 3>{1, 2, 3});
+  REQUIRE(Record::get<"name">(r) == std::string("xy\0\0", 4));
+  REQUIRE(Record::get<"wide">(r) == "hi");
+
+  OutputCursor out;
+  Record::get<"name">(r) = "xy";
+  Record::build(out, r);
+  REQUIRE(out.release() == data);
+
+  // constants and padding are checked with their offset
+  for (size_t at : {1, 3, 5}) {
+    auto bad = data;
+    bad[at] = 'z';
+    InputCursor again(bad);
+    size_t offset = 0;
+    try {
+      Record::parse(again, r);
+    } catch (ParseFailure &e) {
+      offset = e.error.offset;
+    }
+    REQUIRE(offset == (at == 5 ? 5 : at - 1));
+  }
+}
+
+using Strings =
+    StaticStruct<StaticField<"c", CString16l>,
+                 StaticField<"p", PascalString8l<Int8ul>>,
+                 StaticField<"w", PascalString16b<Int16ub>>>;
+
+TEST_CASE("StaticStruct with wide and Pascal strings") {
+  std::vector<char> data = {'a', 0, 'b', 0, 0, 0, 2, 'x', 'y', 0, 2, 0, 'z'};
+  Strings::value_type v;
+  InputCursor cursor(data);
+  Strings::parse(cursor, v);
+  REQUIRE(cursor.tell() == data.size());
+  REQUIRE(Strings::get<"c">(v) == "ab");
+  REQUIRE(Strings::get<"p">(v) == "xy");
+  REQUIRE(Strings::get<"w">(v) == "z");
+  REQUIRE(Strings::size_of(v) == data.size());
+
+  OutputCursor out;
+  Strings::build(out, v);
+  REQUIRE(out.release() == data);
+}
+
+TEST_CASE("Static in a dynamic Switch") {
+  using SField = Switch<int32_t>::SwitchField;
+  auto s = Struct::create(
+      Field("type", Int32sl::create()),
+      Field("body",
+            Switch<int32_t>::create(
+                [](std::weak_ptr<Base> c) {
+                  return lock(c)->get<int32_t>("type");
+                },
+                SField(0, "Int32", []() { return Int32ul::create(); }),
+                SField(1, "Named", []() { return Static<Named>::create(); }))),
+      Field("end", Static<Vec3>::create()));
+  REQUIRE(lock(s->get_field("end"))->fixed_size() == Vec3::size);
+
+  std::vector<char> data = {1, 0, 0, 0, 5, 'a', 'b', 0, 1, 0, 0, 0};
+  float end[3] = {4.0f, 5.0f, 6.0f};
+  data.insert(data.end(), reinterpret_cast<char *>(end),
+              reinterpret_cast<char *>(end) + sizeof(end));
+  InputCursor cursor(data);
+  s->parse(cursor);
+  REQUIRE(s->get<std::string>("body", "name") == "ab");
+  REQUIRE(s->get<uint32_t>("body", "value") == 1);
+  REQUIRE(s->get<float>("end", "z") == 6.0f);
+  REQUIRE(s->get_offset("end") == 12);
+  REQUIRE(s->get_size() == data.size());
+  REQUIRE(s->get_bytes() == data);
+}
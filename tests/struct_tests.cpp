@@ -1,5 +1,6 @@
 #include "basic.hpp"
 #include "number.hpp"
+#include "string.hpp"
 #include "struct.hpp"
 #include <catch2/catch_test_macros.hpp>
 
@@ -136,3 +137,116 @@ TEST_CASE("Struct XML building") {
 )";
   REQUIRE(ss.str() == expected);
 }
+
+TEST_CASE("Struct size memoization") {
+  auto s = Struct::create(
+      Field("a", Int32ul::create()), Field("b", CString16l::create()),
+      Field("c", Struct::create(Field("d", Int16ul::create()))));
+
+  reset_size_cache_stats();
+  REQUIRE(s->get_size() == 4 + 2 + 2);
+  REQUIRE(get_size_cache_stats().misses == 3);
+  REQUIRE(get_size_cache_stats().hits == 0);
+  // the string may be assigned directly, so s adds up the memoized sizes of
+  // its children again
+  REQUIRE(s->get_size() == 4 + 2 + 2);
+  REQUIRE(get_size_cache_stats().misses == 4);
+  REQUIRE(get_size_cache_stats().hits == 2);
+  REQUIRE(!s->size_memoized());
+  REQUIRE(lock(s->get_field("c"))->size_memoized());
+
+  lock(s->get_field("b"))->set(std::string("abc"));
+  REQUIRE(s->get_size() == 4 + 8 + 2);
+  REQUIRE(lock(s->get_field("c"))->size_memoized());
+}
+
+TEST_CASE("Struct size after assigning a string directly") {
+  auto s = Struct::create(Field("a", CString8l::create()),
+                          Field("b", Int32ul::create()));
+  std::vector<char> data = {'a', 'b', 'c', 0, 1, 0, 0, 0};
+  InputCursor cursor(data);
+  s->parse(cursor);
+  REQUIRE(s->get_size() == 8);
+
+  lock(s->get_field<CString8l>("a"))->value = "abcdefgh";
+  REQUIRE(s->get_size() == 13);
+  auto bytes = s->get_bytes();
+  REQUIRE(bytes.size() == 13);
+  REQUIRE(std::string(bytes.data()) == "abcdefgh");
+  REQUIRE(bytes[9] == 1);
+}
+
+TEST_CASE("Struct fixed layout") {
+  auto fixed = Struct::create(
+      Field("magic", BytesConst::create("AB")), Field("a", Int16ub::create()),
+      Field("pad", Padding::create(2)),
+      Field("b", Struct::create(Field("c", Int32ub::create()))));
+  REQUIRE(fixed->is_fixed_layout());
+  REQUIRE(fixed->fixed_size() == 10);
+
+  auto dynamic = Struct::create(Field("a", Int16ub::create()),
+                                Field("b", Int8ul::create()),
+                                Field("s", CString8l::create()),
+                                Field("c", Int32ub::create()));
+  REQUIRE(!dynamic->is_fixed_layout());
+  REQUIRE(!lock(dynamic->get_field("s"))->is_fixed_layout());
+  REQUIRE(lock(dynamic->get_field("c"))->is_fixed_layout());
+
+  std::stringstream data;
+  data.write("AB\x01\x02\0\0\x01\x02\x03\x04", 10);
+  fixed->parse(data);
+  REQUIRE(fixed->get<uint16_t>("a") == 0x0102);
+  REQUIRE(fixed->get<uint32_t>("b", "c") == 0x01020304);
+  REQUIRE(fixed->get_offset("b", "c") == 6);
+  std::stringstream ss;
+  fixed->build(ss);
+  REQUIRE(ss.str() == data.str());
+
+  std::stringstream bad;
+  bad.write("AC\x01\x02\0\0\x01\x02\x03\x04", 10);
+  REQUIRE_THROWS(fixed->parse(bad));
+
+  std::stringstream data2;
+  data2.write("\x01\x02\x03xyz\0\x01\x02\x03\x04", 11);
+  dynamic->parse(data2);
+  REQUIRE(dynamic->get<uint16_t>("a") == 0x0102);
+  REQUIRE(dynamic->get<uint8_t>("b") == 3);
+  REQUIRE(dynamic->get<std::string>("s") == "xyz");
+  REQUIRE(dynamic->get<uint32_t>("c") == 0x01020304);
+  REQUIRE(dynamic->get_offset("c") == 7);
+  std::stringstream ss2;
+  dynamic->build(ss2);
+  REQUIRE(ss2.str() == data2.str());
+}
+
+TEST_CASE("Struct field paths") {
+  auto s = Struct::create(
+      Field("a", Int32sl::create()),
+      Field("c", Struct::create(Field("d", Int16ul::create()),
+                                Field("e", Int16ul::create()))));
+  std::stringstream data;
+  int32_t a = 7;
+  uint16_t d = 3, e = 4;
+  data.write(reinterpret_cast<const char *>(&a), sizeof(a));
+  data.write(reinterpret_cast<const char *>(&d), sizeof(d));
+  data.write(reinterpret_cast<const char *>(&e), sizeof(e));
+  s->parse(data);
+
+  auto c = s->get_field("c");
+  FieldPath sibling("_/a");
+  FieldPath nested{"c", "e"};
+  REQUIRE(sibling.get<int32_t>(c) == 7);
+  REQUIRE(nested.get<uint16_t>(s) == 4);
+  REQUIRE(nested.field(s) == lock(s->get_field<Base>("c", "e")));
+
+  // resolved once, the values are read from the current tree
+  s->get_field<Int16ul>("c", "e").lock()->value = 9;
+  REQUIRE(nested.get<uint16_t>(s) == 9);
+  REQUIRE(s->get<uint16_t>("c", "e") == 9);
+  REQUIRE(s->get<uint16_t>("c", "e") == 9);
+
+  REQUIRE(s->field_index("c") == 1);
+  REQUIRE(s->field_index("x") == std::nullopt);
+  REQUIRE_THROWS(s->get_field("x"));
+  REQUIRE_THROWS(s->get<int32_t>("x"));
+}
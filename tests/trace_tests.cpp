@@ -0,0 +1,111 @@
+#include "array.hpp"
+#include "number.hpp"
+#include "string.hpp"
+#include "struct.hpp"
+#include "trace.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+#include <sstream>
+#include <thread>
+
+using namespace etcetera;
+
+// built with ETCETERA_TRACE, see CMakeLists.txt
+
+TEST_CASE("Trace records parse events") {
+  auto s = Struct::create(
+      Field("count", Int16ul::create()), Field("name", CString8l::create()),
+      Field("values",
+            Array::create(2, []() { return Int32ul::create(); })));
+  std::vector<char> data = {2, 0, 'a', 'b', 0, 1, 0, 0, 0, 2, 0, 0, 0};
+  InputCursor cursor(data);
+
+  trace::clear();
+  s->parse(cursor);
+  auto events = trace::events();
+
+  REQUIRE(events.size() == 6);
+  // count is parsed as a fixed layout run
+  REQUIRE(std::string(events[0].kind) == "Struct::parse_run");
+  REQUIRE(std::string(events[0].name) == "count");
+  REQUIRE(events[0].size == 2);
+  REQUIRE(events[0].depth == 1);
+  REQUIRE(std::string(events[1].kind) == "CString::parse");
+  REQUIRE(events[1].offset == 2);
+  REQUIRE(events[1].size == 3);
+  REQUIRE(std::string(events[3].kind) == "NumberType::parse");
+  REQUIRE(events[3].idx == 1);
+  REQUIRE(events[3].depth == 2);
+  REQUIRE(std::string(events[4].kind) == "Array::parse");
+  REQUIRE(events[4].size == 8);
+  REQUIRE(std::string(events[5].kind) == "Struct::parse");
+  REQUIRE(events[5].size == data.size());
+  REQUIRE(events[5].depth == 0);
+
+  std::stringstream out;
+  trace::dump(out);
+  REQUIRE(out.str().find("  CString::parse [name] offset 2 size 3") !=
+          std::string::npos);
+}
+
+TEST_CASE("Trace records the path of events") {
+  auto s = Struct::create(Field(
+      "entries",
+      Array::create(2, []() {
+        return Struct::create(Field("name", CString8l::create()));
+      })));
+  std::vector<char> data = {'a', 0, 'b', 'c', 0};
+  InputCursor cursor(data);
+
+  trace::clear();
+  s->parse(cursor);
+  auto events = trace::events();
+
+  REQUIRE(events.size() == 6);
+  REQUIRE(events[2].parent == events[3].id);
+  REQUIRE(trace::path(events, events[0]) == "[entries]->0->[name]");
+  REQUIRE(trace::path(events, events[2]) == "[entries]->1->[name]");
+  REQUIRE(trace::path(events, events[3]) == "[entries]->1");
+  REQUIRE(trace::path(events, events[5]) == "");
+}
+
+TEST_CASE("Trace ring buffer keeps the latest events") {
+  trace::clear();
+  for (size_t i = 0; i < 2 * trace::capacity; i++) {
+    trace::Event event;
+    event.kind = "test";
+    event.offset = i;
+    trace::buffer().push(event);
+  }
+  auto events = trace::events();
+  REQUIRE(events.size() == trace::capacity);
+  REQUIRE(events.front().offset == trace::capacity);
+  REQUIRE(events.back().offset == 2 * trace::capacity - 1);
+}
+
+TEST_CASE("Trace ring buffer takes events of many threads") {
+  trace::clear();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; t++) {
+    threads.emplace_back([t]() {
+      for (size_t i = 0; i < trace::capacity; i++) {
+        trace::Event event;
+        event.kind = "test";
+        event.idx = t;
+        event.offset = i;
+        trace::buffer().push(event);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  // slots claimed by overtaken writers are skipped
+  auto events = trace::events();
+  REQUIRE(!events.empty());
+  REQUIRE(events.size() <= trace::capacity);
+  for (auto &event : events) {
+    REQUIRE(std::string(event.kind) == "test");
+    REQUIRE(event.idx < 4);
+  }
+}